@@ -229,7 +229,6 @@ void DBackingStoreProxy::beginPaint(const QRegion &region)
 
             // 在指定区域绘制图片
             p.drawImage(rect, m_wallpaper, rect);
-            m_dirtyRect |= rect;
         }
         p.end();
     }
@@ -238,37 +237,29 @@ void DBackingStoreProxy::beginPaint(const QRegion &region)
         return;
     }
 
-    m_dirtyRect = QRect();
+    m_dirtyRegion = QRegion();
 
     QPainter p(&m_image);
     if (!enable) {
         p.setCompositionMode(QPainter::CompositionMode_Clear);
+    }
 
-        for (QRect rect : region) {
-            rect = QHighDpi::fromNativePixels(rect, window());
-            rect = QRect(rect.topLeft() * window_scale, QHighDpi::toNative(rect.size(), window_scale));
+    for (QRect rect : region) {
+        rect = QHighDpi::fromNativePixels(rect, window());
+        rect = QRect(rect.topLeft() * window_scale, QHighDpi::toNative(rect.size(), window_scale));
 
-            // 如果是透明绘制，应当先清理要绘制的区域
-            if (m_image.format() == QImage::Format_ARGB32_Premultiplied)
-                p.fillRect(rect, Qt::transparent);
+        // 如果是透明绘制，应当先清理要绘制的区域
+        if (!enable && m_image.format() == QImage::Format_ARGB32_Premultiplied)
+            p.fillRect(rect, Qt::transparent);
 
-            m_dirtyRect |= rect;
-        }
+        // 额外扩大一个像素，用于补贴两个不同尺寸图片上的绘图误差
+        m_dirtyRegion += rect.adjusted(-window_scale, -window_scale,
+                                       window_scale, window_scale);
     }
 
     p.end();
 
-    if (m_dirtyRect.isValid()) {
-        // 额外扩大一个像素，用于补贴两个不同尺寸图片上的绘图误差
-        m_dirtyRect.adjust(-window_scale, -window_scale,
-                           window_scale, window_scale);
-
-        m_dirtyWindowRect = QRectF(m_dirtyRect.topLeft() / window_scale,
-                                   m_dirtyRect.size() / window_scale);
-        m_dirtyWindowRect = QHighDpi::toNativePixels(m_dirtyWindowRect, window());
-    } else {
-        m_dirtyWindowRect = QRectF();
-    }
+    m_dirtyRegion &= m_image.rect();
 }
 
 void DBackingStoreProxy::endPaint()
@@ -276,10 +267,18 @@ void DBackingStoreProxy::endPaint()
     if (glDevice)
         return;
 
+    const qreal window_scale = window()->devicePixelRatio();
     QPainter pa(m_proxy->paintDevice());
     pa.setRenderHints(QPainter::SmoothPixmapTransform);
     pa.setCompositionMode(QPainter::CompositionMode_Source);
-    pa.drawImage(m_dirtyWindowRect, m_image, m_dirtyRect);
+
+    // 只缩放绘制本次实际更新的区域，多个分散的小区域不会被合并成覆盖大片未改变内容的外接矩形
+    for (const QRect &rect : m_dirtyRegion) {
+        const QRectF window_rect(rect.topLeft() / window_scale, rect.size() / window_scale);
+
+        pa.drawImage(QHighDpi::toNativePixels(window_rect, window()), m_image, rect);
+    }
+
     pa.end();
 
     m_proxy->endPaint();
@@ -71,8 +71,8 @@ private:
 private:
     QPlatformBackingStore *m_proxy = nullptr;
     QImage m_image;
-    QRectF m_dirtyWindowRect;
-    QRect m_dirtyRect;
+    // m_image 上需要同步到 m_proxy 的区域，按绘制区域逐块记录而不是合并为外接矩形
+    QRegion m_dirtyRegion;
 
     QScopedPointer<DOpenGLPaintDevice> glDevice;
     bool enableGL = false;
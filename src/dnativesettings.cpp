@@ -24,6 +24,8 @@
 #include <QDebug>
 #include <QMetaProperty>
 #include <QMetaMethod>
+#include <QTimer>
+#include <QAbstractEventDispatcher>
 
 #define VALID_PROPERTIES "validProperties"
 #define ALL_KEYS "allKeys"
@@ -31,76 +33,31 @@
 DPP_BEGIN_NAMESPACE
 
 QHash<QObject*, DNativeSettings*> DNativeSettings::mapped;
-/*
- * 通过覆盖QObject的qt_metacall虚函数，检测base object中自定义的属性列表，将xwindow对应的设置和object对象中的属性绑定到一起使用
- * 将对象通过property/setProperty调用对属性的读写操作转为对xsetting的属性设 置
- */
-DNativeSettings::DNativeSettings(QObject *base, DPlatformSettings *settings, bool global_settings)
-    : m_base(base)
-    , m_settings(settings)
-    , m_isGlobalSettings(global_settings)
-{
-    if (mapped.value(base)) {
-        qCritical() << "DNativeSettings: Native settings are already initialized for object:" << base;
-        std::abort();
-    }
-
-    mapped[base] = this;
-
-    const QMetaObject *meta_object;
-
-    if (qintptr ptr = qvariant_cast<qintptr>(m_base->property("_d_metaObject"))) {
-        meta_object = reinterpret_cast<const QMetaObject*>(ptr);
-    } else {
-        meta_object = m_base->metaObject();
-    }
-
-    if (m_settings->initialized()) {
-        init(meta_object);
-    }
-}
 
-DNativeSettings::~DNativeSettings()
+// 以'_'开头的属性认为是私有的，不自动关联到native Settings
+static bool isSettingsPropertyName(const char *name)
 {
-    if (!m_isGlobalSettings) {
-        delete m_settings;
-    } else if (
-#ifdef IN_DXCB_PLUGIN
-        DPlatformIntegration::instance() &&
-#endif
-        m_settings->initialized()
-        ) {
-        // 移除注册的callback
-        m_settings->removeCallbackForHandle(this);
-        m_settings->removeSignalCallback(this);
-    }
-
-    mapped.remove(m_base);
-
-    if (m_metaObject) {
-        free(m_metaObject);
-    }
+    return name[0] != '\0' && name[0] != '_'
+            && QByteArrayLiteral(VALID_PROPERTIES) != name
+            && QByteArrayLiteral(ALL_KEYS) != name;
 }
 
-bool DNativeSettings::isValid() const
+QHash<DNativeSettingsMeta::Key, DNativeSettingsMeta*> DNativeSettingsMeta::sharedMetas;
+
+DNativeSettingsMeta::~DNativeSettingsMeta()
 {
-    return m_settings->initialized();
+    free(metaObject);
 }
 
-// TODO: This class needs to add a unit test
-void DNativeSettings::init(const QMetaObject *metaObject)
+void DNativeSettingsMeta::build()
 {
-    m_objectBuilder.addMetaObject(metaObject);
-    m_firstProperty = metaObject->propertyOffset();
-    m_propertyCount = m_objectBuilder.propertyCount();
-    // 用于记录属性是否有效的属性, 属性类型为64位整数，最多可用于记录64个属性的状态
-    m_flagPropertyIndex = metaObject->indexOfProperty(VALID_PROPERTIES);
-    qint64 validProperties = 0;
-    // 用于记录所有属性的key
-    m_allKeysPropertyIndex = metaObject->indexOfProperty(ALL_KEYS);
-    int allKeyPropertyTyep = 0;
+    QMetaObjectBuilder &ob = builder;
+    ob.addMetaObject(source);
 
-    QMetaObjectBuilder &ob = m_objectBuilder;
+    const int first_property = source->propertyOffset();
+    const int property_count = ob.propertyCount();
+    const int flag_property_index = source->indexOfProperty(VALID_PROPERTIES);
+    const int all_keys_property_index = source->indexOfProperty(ALL_KEYS);
 
 #if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
     ob.setFlags(ob.flags() | DynamicMetaObject);
@@ -113,38 +70,29 @@ void DNativeSettings::init(const QMetaObject *metaObject)
         ob.removeProperty(0);
     }
 
-    QVector<int> propertySignalIndex;
-    propertySignalIndex.reserve(m_propertyCount);
+    propertySignalIndexes.reserve(property_count);
+    propertyIndexes.reserve(property_count);
+    propertyKeys.reserve(property_count);
 
     // QMetaObjectBuilder对象中的属性、信号、方法均从0开始，但是m_base对象的QMetaObject则包含offset
     // 因此往QMetaObjectBuilder对象中添加属性时要将其对应的信号的index减去偏移量
-    int signal_offset = metaObject->methodOffset();
+    int signal_offset = source->methodOffset();
 
-    for (int i = 0; i < m_propertyCount; ++i) {
-        int index = i + m_firstProperty;
+    for (int i = 0; i < property_count; ++i) {
+        int index = i + first_property;
 
-        const QMetaProperty &mp = metaObject->property(index);
+        const QMetaProperty &mp = source->property(index);
 
         if (mp.hasNotifySignal()) {
-            propertySignalIndex << mp.notifySignalIndex();
+            propertySignalIndexes << mp.notifySignalIndex();
         }
 
         // 跳过特殊属性
-        if (index == m_flagPropertyIndex) {
-            ob.addProperty(mp);
-            continue;
-        }
-
-        if (index == m_allKeysPropertyIndex) {
-            ob.addProperty(mp);
-            allKeyPropertyTyep = mp.userType();
+        if (index == flag_property_index || index == all_keys_property_index) {
+            insertPropertyIndex(mp.name(), ob.addProperty(mp).index());
             continue;
         }
 
-        if (m_settings->setting(mp.name()).isValid()) {
-            validProperties |= (1 << i);
-        }
-
         QMetaPropertyBuilder op;
 
 #if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
@@ -170,25 +118,199 @@ void DNativeSettings::init(const QMetaObject *metaObject)
             // 声明支持属性reset
             op.setResettable(true);
         }
+
+        insertPropertyIndex(mp.name(), op.index());
     }
 
     {
         // 通过class info确定是否应该关联对象的信号
-        int index = metaObject->indexOfClassInfo("SignalType");
+        int index = source->indexOfClassInfo("SignalType");
 
         if (index >= 0) {
-            const QByteArray signals_value(metaObject->classInfo(index).value());
+            const QByteArray signals_value(source->classInfo(index).value());
 
             // 如果base对象声明为信号的生产者，则应该将其产生的信号转发到native settings
             if (signals_value == "producer") {
                 // 创建一个槽用于接收所有信号
-                m_relaySlotIndex = ob.addMethod("relaySlot(QByteArray,qint32,qint32)").index() + metaObject->methodOffset();
+                relaySlotIndex = ob.addMethod("relaySlot(QByteArray,qint32,qint32)").index() + source->methodOffset();
             }
         }
     }
 
+    for (const QByteArray &key : extraKeys)
+        addProperty(key);
+
+    update();
+}
+
+int DNativeSettingsMeta::addProperty(const QByteArray &name)
+{
+    auto property = builder.addProperty(name, "QVariant");
+    property.setReadable(true);
+    property.setWritable(true);
+    property.setResettable(true);
+    insertPropertyIndex(name, property.index());
+
+    return property.index();
+}
+
+void DNativeSettingsMeta::insertPropertyIndex(const QByteArray &name, int index)
+{
+    propertyIndexes.insert(name, index);
+
+    if (propertyKeys.size() <= index)
+        propertyKeys.resize(index + 1);
+
+    propertyKeys[index] = name;
+}
+
+void DNativeSettingsMeta::update()
+{
+    free(metaObject);
+    metaObject = builder.toMetaObject();
+}
+
+DNativeSettingsMeta *DNativeSettingsMeta::acquire(const QMetaObject *source, const QByteArrayList &extraKeys)
+{
+    DNativeSettingsMeta *&meta = sharedMetas[Key(source, extraKeys)];
+
+    if (!meta) {
+        meta = new DNativeSettingsMeta(source, extraKeys);
+        meta->build();
+    }
+
+    ++meta->ref;
+    return meta;
+}
+
+// 返回在meta之后追加了keys的元对象，meta的引用会被释放
+DNativeSettingsMeta *DNativeSettingsMeta::extend(DNativeSettingsMeta *meta, const QByteArrayList &keys)
+{
+    DNativeSettingsMeta *extended = acquire(meta->source, meta->extraKeys + keys);
+    release(meta);
+
+    return extended;
+}
+
+void DNativeSettingsMeta::release(DNativeSettingsMeta *meta)
+{
+    if (!meta || --meta->ref > 0)
+        return;
+
+    // 元对象的地址可能会被重新使用，不再使用时要及时从缓存中移除
+    sharedMetas.remove(Key(meta->source, meta->extraKeys));
+    delete meta;
+}
+/*
+ * 通过覆盖QObject的qt_metacall虚函数，检测base object中自定义的属性列表，将xwindow对应的设置和object对象中的属性绑定到一起使用
+ * 将对象通过property/setProperty调用对属性的读写操作转为对xsetting的属性设 置
+ */
+DNativeSettings::DNativeSettings(QObject *base, DPlatformSettings *settings, bool global_settings)
+    : m_base(base)
+    , m_settings(settings)
+    , m_isGlobalSettings(global_settings)
+{
+    if (mapped.value(base)) {
+        qCritical() << "DNativeSettings: Native settings are already initialized for object:" << base;
+        std::abort();
+    }
+
+    mapped[base] = this;
+
+    const QMetaObject *meta_object;
+
+    if (qintptr ptr = qvariant_cast<qintptr>(m_base->property("_d_metaObject"))) {
+        meta_object = reinterpret_cast<const QMetaObject*>(ptr);
+    } else {
+        meta_object = m_base->metaObject();
+    }
+
+    if (m_settings->initialized()) {
+        init(meta_object);
+    }
+}
+
+DNativeSettings::~DNativeSettings()
+{
+    if (!m_isGlobalSettings) {
+        commitSettingsTransaction();
+        delete m_settings;
+    } else {
+        bool settings_alive = true;
+#ifdef IN_DXCB_PLUGIN
+        // 全局的settings对象随DPlatformIntegration一起销毁，其事务计数也随之失效，此时无需也不能再提交
+        settings_alive = DPlatformIntegration::instance();
+#endif
+
+        if (settings_alive) {
+            // 无论settings是否已初始化都要提交，否则共享的事务计数无法恢复，之后的写入将永远不会生效
+            commitSettingsTransaction();
+
+            if (m_settings->initialized()) {
+                // 移除注册的callback
+                m_settings->removeCallbackForHandle(this);
+                m_settings->removeSignalCallback(this);
+            }
+        }
+    }
+
+    mapped.remove(m_base);
+    DNativeSettingsMeta::release(m_meta);
+}
+
+bool DNativeSettings::isValid() const
+{
+    return m_settings->initialized();
+}
+
+// TODO: This class needs to add a unit test
+void DNativeSettings::init(const QMetaObject *metaObject)
+{
+    m_meta = DNativeSettingsMeta::acquire(metaObject);
+    m_firstProperty = metaObject->propertyOffset();
+    m_propertyCount = metaObject->propertyCount() - m_firstProperty;
+    // 用于记录属性是否有效的属性, 属性类型为QBitArray时可记录任意数量属性的状态，为64位整数时只能记录前64个属性的状态
+    m_flagPropertyIndex = metaObject->indexOfProperty(VALID_PROPERTIES);
+    m_flagPropertyType = m_flagPropertyIndex >= 0 ? metaObject->property(m_flagPropertyIndex).userType() : 0;
+    m_validProperties = QBitArray(m_meta->propertyKeys.size());
+    // 用于记录所有属性的key
+    m_allKeysPropertyIndex = metaObject->indexOfProperty(ALL_KEYS);
+    int allKeyPropertyTyep = 0;
+    m_relaySlotIndex = m_meta->relaySlotIndex;
+
+    for (int i = 0; i < m_propertyCount; ++i) {
+        int index = i + m_firstProperty;
+
+        // 跳过特殊属性
+        if (index == m_flagPropertyIndex) {
+            continue;
+        }
+
+        const QMetaProperty &mp = metaObject->property(index);
+
+        if (index == m_allKeysPropertyIndex) {
+            allKeyPropertyTyep = mp.userType();
+            continue;
+        }
+
+        if (m_settings->setting(m_meta->propertyKeys.at(i)).isValid()) {
+            m_validProperties.setBit(i);
+        }
+    }
+
     // 将属性状态设置给对象
-    m_base->setProperty(VALID_PROPERTIES, validProperties);
+    if (m_flagPropertyType == QMetaType::QBitArray) {
+        m_base->setProperty(VALID_PROPERTIES, m_validProperties);
+    } else {
+        qint64 validProperties = 0;
+
+        for (int i = 0; i < qMin(m_validProperties.size(), 64); ++i) {
+            if (m_validProperties.testBit(i))
+                validProperties |= (qint64(1) << i);
+        }
+
+        m_base->setProperty(VALID_PROPERTIES, validProperties);
+    }
 
     // 将所有属性名称设置给对象
     if (allKeyPropertyTyep == qMetaTypeId<QSet<QByteArray>>()) {
@@ -209,12 +331,9 @@ void DNativeSettings::init(const QMetaObject *metaObject)
     // 支持在base对象中直接使用property/setProperty读写native属性
     QObjectPrivate *op = QObjectPrivate::get(m_base);
     op->metaObject = this;
-    m_metaObject = ob.toMetaObject();
-    *static_cast<QMetaObject *>(this) = *m_metaObject;
+    updateMetaObject();
 
     if (isRelaySignal()) {
-        // 把 static_metacall 置为nullptr，迫使对base对象调用QMetaObject::invodeMethod时使用DNativeSettings::metaCall
-        d.static_metacall = nullptr;
         // 链接 base 对象的所有信号
         int first_method = methodOffset();
         int method_count = methodCount();
@@ -223,7 +342,7 @@ void DNativeSettings::init(const QMetaObject *metaObject)
             int index = i + first_method;
 
             // 排除属性对应的信号
-            if (propertySignalIndex.contains(index)) {
+            if (m_meta->propertySignalIndexes.contains(index)) {
                 continue;
             }
 
@@ -238,6 +357,16 @@ void DNativeSettings::init(const QMetaObject *metaObject)
     }
 }
 
+void DNativeSettings::updateMetaObject()
+{
+    *static_cast<QMetaObject *>(this) = *m_meta->metaObject;
+
+    if (isRelaySignal()) {
+        // 把 static_metacall 置为nullptr，迫使对base对象调用QMetaObject::invodeMethod时使用DNativeSettings::metaCall
+        d.static_metacall = nullptr;
+    }
+}
+
 QByteArray DNativeSettings::getSettingsProperty(QObject *base)
 {
     const QMetaObject *meta_object;
@@ -277,30 +406,51 @@ QByteArray DNativeSettings::getSettingsProperty(QObject *base)
 
 int DNativeSettings::createProperty(const char *name, const char *)
 {
-    // 不处理空字符串
-    if (strlen(name) == 0) {
+    // 不处理空字符串, 不创建特殊属性
+    if (!m_meta || !isSettingsPropertyName(name)) {
         return -1;
     }
 
-    // 不创建特殊属性(以'_'开头的属性认为是私有的，不自动关联到native Settings)
-    if (QByteArrayLiteral(VALID_PROPERTIES) == name
-            || QByteArrayLiteral(ALL_KEYS) == name
-            || name[0] == '_') {
-        return -1;
+    const QByteArray property_name(name);
+    QByteArrayList keys { property_name };
+
+    // 属性通常是在读写设置项时才会被创建，此处一次性为所有还没有对应属性的设置项创建属性，
+    // 避免之后每访问一个设置项都要重新构建一次元对象. 全局的XSETTINGS中有数百个设置项，
+    // 而对象通常只会访问其中几个，因此只为指定了域的设置批量创建属性
+    if (!m_isGlobalSettings) {
+        for (const QByteArray &key : m_settings->settingKeys()) {
+            if (key != property_name
+                    && !m_meta->propertyIndexes.contains(key)
+                    && isSettingsPropertyName(key.constData())
+                    && m_meta->source->indexOfProperty(key.constData()) < 0) {
+                keys << key;
+            }
+        }
     }
 
-    // 清理旧数据
-    free(m_metaObject);
+    // 缓存中的元对象不能修改，切换到添加了新属性的元对象，其它添加了相同属性的对象会共享此元对象
+    m_meta = DNativeSettingsMeta::extend(m_meta, keys);
+    updateMetaObject();
 
-    // 添加新属性
-    auto property = m_objectBuilder.addProperty(name, "QVariant");
-    property.setReadable(true);
-    property.setWritable(true);
-    property.setResettable(true);
-    m_metaObject = m_objectBuilder.toMetaObject();
-    *static_cast<QMetaObject *>(this) = *m_metaObject;
+    // 记录新增属性的状态
+    const int old_count = m_validProperties.size();
+    m_validProperties.resize(m_meta->propertyKeys.size());
 
-    return m_firstProperty + property.index();
+    for (int i = old_count; i < m_validProperties.size(); ++i) {
+        m_validProperties.setBit(i, m_settings->setting(m_meta->propertyKeys.at(i)).isValid());
+    }
+
+    return m_firstProperty + m_meta->propertyIndexes.value(property_name);
+}
+
+// 属性的类型一致时直接访问QVariant中的数据，避免复制整个集合
+template<typename Keys>
+static bool containsKey(const QVariant &keys, const QByteArray &key)
+{
+    if (keys.userType() == qMetaTypeId<Keys>())
+        return static_cast<const Keys *>(keys.constData())->contains(key);
+
+    return qvariant_cast<Keys>(keys).contains(key);
 }
 
 void DNativeSettings::onPropertyChanged(const QByteArray &name, const QVariant &property, DNativeSettings *handle)
@@ -312,56 +462,59 @@ void DNativeSettings::onPropertyChanged(const QByteArray &name, const QVariant &
     // 重设对象的 ALL_KEYS 属性
     {
         const QVariant &old_property = handle->m_base->property(ALL_KEYS);
+        const bool is_set = old_property.canConvert<QSet<QByteArray>>();
+        const bool contains = is_set ? containsKey<QSet<QByteArray>>(old_property, name)
+                                     : containsKey<QByteArrayList>(old_property, name);
 
-        if (old_property.canConvert<QSet<QByteArray>>()) {
-            QSet<QByteArray> keys = qvariant_cast<QSet<QByteArray>>(old_property);
-            int old_count = keys.count();
+        // 大多数情况下只是设置项的值发生变化，只有设置项被添加或者移除时才需要复制并更新集合
+        if (contains != property.isValid()) {
+            if (is_set) {
+                QSet<QByteArray> keys = qvariant_cast<QSet<QByteArray>>(old_property);
 
-            if (property.isValid()) {
-                keys << name;
-            } else if (keys.contains(name)) {
-                keys.remove(name);
-            }
+                if (property.isValid()) {
+                    keys << name;
+                } else {
+                    keys.remove(name);
+                }
 
-            // 数量无变化时说明值无变化
-            if (old_count != keys.count()) {
                 handle->m_base->setProperty(ALL_KEYS, QVariant::fromValue(keys));
-            }
-        } else {
-            bool changed = false;
-            QByteArrayList keys = qvariant_cast<QByteArrayList>(old_property);
+            } else {
+                QByteArrayList keys = qvariant_cast<QByteArrayList>(old_property);
 
-            if (property.isValid()) {
-                if (!keys.contains(name)) {
+                if (property.isValid()) {
                     keys << name;
-                    changed = true;
+                } else {
+                    keys.removeOne(name);
                 }
-            } else if (keys.contains(name)) {
-                keys.removeOne(name);
-                changed = true;
-            }
 
-            if (changed) {
                 handle->m_base->setProperty(ALL_KEYS, QVariant::fromValue(keys));
             }
         }
     }
 
     // 不要直接调用自己的indexOfProperty函数，属性不存在时会导致调用createProperty函数
-    int property_index = handle->m_objectBuilder.indexOfProperty(name.constData());
+    int property_index = handle->m_meta ? handle->m_meta->propertyIndexes.value(name, -1) : -1;
 
     if (Q_UNLIKELY(property_index < 0)) {
         return;
     }
 
-    {
-        bool ok = false;
-        qint64 flags = handle->m_base->property(VALID_PROPERTIES).toLongLong(&ok);
-        // 更新有效属性的标志位
-        if (ok) {
-            qint64 flag = (1 << property_index);
-            flags = property.isValid() ? flags | flag : flags & ~flag;
-            handle->m_base->setProperty(VALID_PROPERTIES, flags);
+    // 更新有效属性的标志位，状态无变化时无需更新对象的属性
+    if (property_index < handle->m_validProperties.size()
+            && handle->m_validProperties.testBit(property_index) != property.isValid()) {
+        handle->m_validProperties.setBit(property_index, property.isValid());
+
+        if (handle->m_flagPropertyType == QMetaType::QBitArray) {
+            handle->m_base->setProperty(VALID_PROPERTIES, handle->m_validProperties);
+        } else if (property_index < 64) {
+            bool ok = false;
+            qint64 flags = handle->m_base->property(VALID_PROPERTIES).toLongLong(&ok);
+
+            if (ok) {
+                qint64 flag = (qint64(1) << property_index);
+                flags = property.isValid() ? flags | flag : flags & ~flag;
+                handle->m_base->setProperty(VALID_PROPERTIES, flags);
+            }
         }
     }
 
@@ -412,16 +565,22 @@ int DNativeSettings::metaCall(QMetaObject::Call _c, int _id, void ** _a)
         // 对于本地属性，此处应该从m_settings中读写
         if (Q_LIKELY(index != m_flagPropertyIndex && index != m_allKeysPropertyIndex
                      && index >= m_firstProperty)) {
+            const int key_index = index - m_firstProperty;
+            const QByteArray &key = key_index < m_meta->propertyKeys.size()
+                    ? m_meta->propertyKeys.at(key_index) : QByteArray(p.name());
+
             switch (_c) {
             case QMetaObject::ReadProperty:
-                *reinterpret_cast<QVariant*>(_a[1]) = m_settings->setting(p.name());
+                *reinterpret_cast<QVariant*>(_a[1]) = m_settings->setting(key);
                 _a[0] = reinterpret_cast<QVariant*>(_a[1])->data();
                 break;
             case QMetaObject::WriteProperty:
-                m_settings->setSetting(p.name(), *reinterpret_cast<QVariant*>(_a[1]));
+                beginSettingsTransaction();
+                m_settings->setSetting(key, *reinterpret_cast<QVariant*>(_a[1]));
                 break;
             case QMetaObject::ResetProperty:
-                m_settings->setSetting(p.name(), QVariant());
+                beginSettingsTransaction();
+                m_settings->setSetting(key, QVariant());
                 break;
             default:
                 break;
@@ -486,4 +645,31 @@ bool DNativeSettings::isRelaySignal() const
     return m_relaySlotIndex > 0;
 }
 
+// 同一次事件循环中对属性的多次写入合并为一个事务，回到事件循环时一次写入
+void DNativeSettings::beginSettingsTransaction()
+{
+    if (m_transactionPending)
+        return;
+
+    // 所在线程没有事件循环时无法延迟提交，不开启事务，每次写入立即生效
+    if (!QAbstractEventDispatcher::instance(m_base->thread()))
+        return;
+
+    m_transactionPending = true;
+    m_settings->beginSettingsTransaction();
+    // base对象销毁时会取消此调用，析构函数中会提交未完成的事务
+    QTimer::singleShot(0, m_base, [this] {
+        commitSettingsTransaction();
+    });
+}
+
+void DNativeSettings::commitSettingsTransaction()
+{
+    if (!m_transactionPending)
+        return;
+
+    m_transactionPending = false;
+    m_settings->commitSettingsTransaction();
+}
+
 DPP_END_NAMESPACE
@@ -12,11 +12,55 @@
 #include "global.h"
 
 #include <QSet>
+#include <QBitArray>
 #include <private/qmetaobjectbuilder_p.h>
 
 DPP_BEGIN_NAMESPACE
 
 class DPlatformSettings;
+
+/*
+ * 动态元对象只与base对象的QMetaObject及动态添加的属性有关，以二者为键缓存构建结果，
+ * 使用相同QMetaObject且添加了相同属性的对象共享同一份元对象，缓存中的元对象不会被修改
+ */
+class DNativeSettingsMeta
+{
+public:
+    typedef QPair<const QMetaObject*, QByteArrayList> Key;
+
+    explicit DNativeSettingsMeta(const QMetaObject *source, const QByteArrayList &extraKeys)
+        : source(source)
+        , extraKeys(extraKeys)
+    {}
+
+    ~DNativeSettingsMeta();
+
+    void build();
+    int addProperty(const QByteArray &name);
+    void insertPropertyIndex(const QByteArray &name, int index);
+    void update();
+
+    static DNativeSettingsMeta *acquire(const QMetaObject *source, const QByteArrayList &extraKeys = QByteArrayList());
+    static DNativeSettingsMeta *extend(DNativeSettingsMeta *meta, const QByteArrayList &keys);
+    static void release(DNativeSettingsMeta *meta);
+
+    const QMetaObject *source;
+    // 在source的属性之后动态添加的属性，按添加的顺序排列
+    const QByteArrayList extraKeys;
+    QMetaObjectBuilder builder;
+    QMetaObject *metaObject = nullptr;
+    // 属性名称到QMetaObjectBuilder中属性index的映射
+    QHash<QByteArray, int> propertyIndexes;
+    // QMetaObjectBuilder中属性index到设置项名称的映射，读写属性时无需再从属性名称构造key
+    QVector<QByteArray> propertyKeys;
+    // 属性对应的信号在base对象中的index
+    QVector<int> propertySignalIndexes;
+    int relaySlotIndex = 0;
+    int ref = 0;
+
+    static QHash<Key, DNativeSettingsMeta*> sharedMetas;
+};
+
 class DNativeSettings : public QAbstractDynamicMetaObject
 {
 public:
@@ -28,29 +72,40 @@ public:
 
 private:
     void init(const QMetaObject *meta_object);
+    void updateMetaObject();
 
     int createProperty(const char *, const char *) override;
     int metaCall(QMetaObject::Call, int _id, void **) override;
     bool isRelaySignal() const;
+    // 对属性的写入会立即更新本地的值，但同步给X server及其它客户端的操作延迟到base对象所在线程的
+    // 事件循环中一次性提交；线程没有事件循环时每次写入立即同步。析构时会提交未完成的写入
+    void beginSettingsTransaction();
+    void commitSettingsTransaction();
 
     static void onPropertyChanged(const QByteArray &name, const QVariant &property, DNativeSettings *handle);
     static void onSignal(const QByteArray &signal, qint32 data1, qint32 data2, DNativeSettings *handle);
 
     QObject *m_base;
-    QMetaObject *m_metaObject = nullptr;
-    QMetaObjectBuilder m_objectBuilder;
+    // 由base对象的QMetaObject构建的动态元对象，相同类型且动态添加了相同属性的对象之间共享
+    DNativeSettingsMeta *m_meta = nullptr;
     int m_firstProperty;
     int m_propertyCount;
     // propertyChanged信号的index
     int m_propertySignalIndex;
     // VALID_PROPERTIES属性的index
     int m_flagPropertyIndex;
+    // VALID_PROPERTIES属性的类型, 为QBitArray时不限制属性的数量
+    int m_flagPropertyType = 0;
+    // 每个属性对应的设置项是否有效，下标为属性在QMetaObjectBuilder中的index
+    QBitArray m_validProperties;
     // ALL_KEYS属性的index
     int m_allKeysPropertyIndex;
     // 用于转发base对象产生的信号的槽，使用native settings的接口将其发送出去. 值为0时表示不转发base对象的所有信号
     int m_relaySlotIndex = 0;
     DPlatformSettings *m_settings = nullptr;
     bool m_isGlobalSettings = false;
+    // 已开启事务，等待回到事件循环时提交
+    bool m_transactionPending = false;
 
     static QHash<QObject*, DNativeSettings*> mapped;
 };
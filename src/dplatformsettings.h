@@ -27,6 +27,9 @@ public:
     virtual QVariant setting(const QByteArray &property) const = 0;
     virtual void setSetting(const QByteArray &property, const QVariant &value) = 0;
     virtual QByteArrayList settingKeys() const = 0;
+    // 事务中的修改在提交时一次写入，不支持事务时每次修改都会立即写入
+    virtual void beginSettingsTransaction() {}
+    virtual void commitSettingsTransaction() {}
 
     virtual void emitSignal(const QByteArray &signal, qint32 data1, qint32 data2) = 0;
 
@@ -18,26 +18,62 @@
 #ifdef __D_HAS_DPLATFORMINTEGRATION__
 #include "dplatformintegration.h"
 #include "qxcbconnection.h"
+#include "dxcbroundtrip.h"
+#include "utility.h"
 #define IN_DXCB_PLUGIN
+#else
+#define D_XCB_ROUNDTRIP(call) call
+#define D_XCB_ROUNDTRIP_OPERATION(name)
 #endif
 
 #include <QtCore/QByteArray>
 #include <QtCore/QtEndian>
 #include <QVariant>
 #include <QSet>
+#include <QVarLengthArray>
+#include <QMutex>
 #include <QColor>
 
 #include <vector>
 #include <algorithm>
 #include <memory>
 
+#ifdef IN_DXCB_PLUGIN
+static xcb_atom_t internAtom(xcb_connection_t *conn, const char *name)
+{
+    return deepin_platform_plugin::Utility::internAtom(conn, name, false);
+}
+#else
+namespace {
+struct XSettingsAtomCache {
+    QMutex mutex;
+    xcb_connection_t *connection = nullptr;
+    QHash<QByteArray, xcb_atom_t> atoms;
+};
+}
+
+Q_GLOBAL_STATIC(XSettingsAtomCache, xsettingsAtomCache)
+
 static xcb_atom_t internAtom(xcb_connection_t *conn, const char *name)
 {
     if (!name || *name == 0)
         return XCB_NONE;
 
+    const QByteArray key = QByteArray::fromRawData(name, int(strlen(name)));
+
+    {
+        QMutexLocker locker(&xsettingsAtomCache->mutex);
+
+        if (xsettingsAtomCache->connection == conn) {
+            auto it = xsettingsAtomCache->atoms.constFind(key);
+
+            if (it != xsettingsAtomCache->atoms.constEnd())
+                return it.value();
+        }
+    }
+
     xcb_intern_atom_cookie_t cookie = xcb_intern_atom(conn, false, strlen(name), name);
-    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(conn, cookie, 0);
+    xcb_intern_atom_reply_t *reply = D_XCB_ROUNDTRIP(xcb_intern_atom_reply(conn, cookie, 0));
 
     if (!reply)
         return XCB_NONE;
@@ -45,13 +81,24 @@ static xcb_atom_t internAtom(xcb_connection_t *conn, const char *name)
     xcb_atom_t atom = reply->atom;
     free(reply);
 
+    QMutexLocker locker(&xsettingsAtomCache->mutex);
+
+    // 只缓存一个连接的atom，连接变化时丢弃旧的缓存
+    if (xsettingsAtomCache->connection != conn) {
+        xsettingsAtomCache->connection = conn;
+        xsettingsAtomCache->atoms.clear();
+    }
+
+    xsettingsAtomCache->atoms.insert(QByteArray(name), atom);
+
     return atom;
 }
+#endif
 
 [[maybe_unused]] static QByteArray atomName(xcb_connection_t *conn, xcb_atom_t atom)
 {
     xcb_get_atom_name_cookie_t cookie = xcb_get_atom_name(conn, atom);
-    xcb_get_atom_name_reply_t *reply = xcb_get_atom_name_reply(conn, cookie, nullptr);
+    xcb_get_atom_name_reply_t *reply = D_XCB_ROUNDTRIP(xcb_get_atom_name_reply(conn, cookie, nullptr));
 
     if (!reply)
         return nullptr;
@@ -94,6 +141,12 @@ struct Q_DECL_HIDDEN DXcbXSettingsCallback
     void *handle;
 };
 
+struct Q_DECL_HIDDEN DXcbXSettingsPropertiesCallback
+{
+    DXcbXSettings::PropertiesChangeFunc func;
+    void *handle;
+};
+
 struct Q_DECL_HIDDEN DXcbXSettingsSignalCallback
 {
     DXcbXSettings::SignalFunc func;
@@ -128,6 +181,10 @@ public:
     QVariant value;
     int last_change_serial = -1;
     std::vector<DXcbXSettingsCallback> callback_links;
+    // 上一次解析时此设置项在原始数据中的位置，用于跳过未变化的项
+    int data_offset = -1;
+    int data_length = 0;
+    quint32 generation = 0;
 };
 
 class Q_DECL_HIDDEN DXcbConnectionGrabber
@@ -190,6 +247,10 @@ public:
             _xsettings_signal_atom = internAtom(connection,"_XSETTINGS_SETTINGS_SIGNAL");
         }
 
+        if (!_xsettings_type_atom) {
+            _xsettings_type_atom = internAtom(connection, "_XSETTINGS_SETTINGS");
+        }
+
         // init xsettings owner
         if (!_xsettings_owner) {
             _xsettings_owner = DXcbXSettings::getOwner(connection, 0);
@@ -202,60 +263,110 @@ public:
         }
     }
 
-    QByteArray getSettings()
+    // 读取一段属性数据，窗口无效时返回false
+    bool readSettings(quint32 offset, quint32 length, QByteArray *settings, quint32 *bytes_after)
     {
-        DXcbConnectionGrabber connectionGrabber(connection);
-        Q_UNUSED(connectionGrabber)
-        int offset = 0;
-        QByteArray settings;
-        while (1) {
-            xcb_get_property_cookie_t cookie = xcb_get_property(connection,
-                                                                false,
-                                                                x_settings_window,
-                                                                x_settings_atom,
-                                                                internAtom(connection, "_XSETTINGS_SETTINGS"),
-                                                                offset/4,
-                                                                8192);
-
-            xcb_generic_error_t *error = nullptr;
-            auto reply = xcb_get_property_reply(connection, cookie, &error);
-
-            enum ErrorCode {
-                BadWindow = 3
-            };
-
-            // 在窗口无效时，应当认为此native settings未初始化完成
-            if (error && error->error_code == ErrorCode::BadWindow) {
+        xcb_get_property_cookie_t cookie = xcb_get_property(connection,
+                                                            false,
+                                                            x_settings_window,
+                                                            x_settings_atom,
+                                                            _xsettings_type_atom,
+                                                            offset / 4,
+                                                            length / 4);
+
+        xcb_generic_error_t *error = nullptr;
+        auto reply = D_XCB_ROUNDTRIP(xcb_get_property_reply(connection, cookie, &error));
+
+        enum ErrorCode {
+            BadWindow = 3
+        };
+
+        // 在窗口无效时，应当认为此native settings未初始化完成
+        if (error) {
+            const bool bad_window = error->error_code == ErrorCode::BadWindow;
+            free(error);
+
+            if (bad_window) {
                 initialized = false;
-                return settings;
+                return false;
             }
+        }
+
+        *bytes_after = 0;
+        if (!reply)
+            return true;
 
-            bool more = false;
-            if (!reply)
+        const auto property_value_length = xcb_get_property_value_length(reply);
+        settings->append(static_cast<const char *>(xcb_get_property_value(reply)), property_value_length);
+        *bytes_after = reply->bytes_after;
+        free(reply);
+
+        return true;
+    }
+
+    QByteArray getSettings()
+    {
+        // 写入方总是通过一次REPLACE请求替换整个属性，因此一次读取的结果一定是完整的，无需grab server。
+        // 第一次请求即要求返回整个属性，只有数据在两次请求之间被修改时才会出现剩余数据，
+        // 此时比较数据头中的serial，不一致时说明读到的是不同版本的数据，需要重新读取
+        enum { MaxRetries = 3 };
+        QByteArray settings;
+
+        for (int retry = 0; retry < MaxRetries; ++retry) {
+            settings.resize(0);
+            quint32 bytes_after = 0;
+
+            if (!readSettings(0, UINT32_MAX, &settings, &bytes_after))
+                return QByteArray();
+
+            if (bytes_after == 0)
                 return settings;
 
-            const auto property_value_length = xcb_get_property_value_length(reply);
-            settings.append(static_cast<const char *>(xcb_get_property_value(reply)), property_value_length);
-            offset += property_value_length;
-            more = reply->bytes_after != 0;
-            free(reply);
+            QByteArray header;
+            quint32 header_bytes_after = 0;
+
+            if (!readSettings(settings.size(), bytes_after, &settings, &bytes_after)
+                    || !readSettings(0, 12, &header, &header_bytes_after))
+                return QByteArray();
 
-            if (!more)
-                break;
+            if (bytes_after == 0 && header.size() >= 12 && settings.size() >= 12
+                    && memcmp(header.constData(), settings.constData(), 12) == 0)
+                return settings;
         }
 
+        // 属性被频繁修改，多次重试仍未读到一致的数据，此时grab server后再读取，保证不会混合不同版本的数据
+        DXcbConnectionGrabber connectionGrabber(connection);
+        Q_UNUSED(connectionGrabber)
+        quint32 bytes_after = 0;
+
+        settings.resize(0);
+
+        if (!readSettings(0, UINT32_MAX, &settings, &bytes_after) || bytes_after != 0)
+            return QByteArray();
+
         return settings;
     }
 
+    // 窗口id的高位是X server分配给每个客户端的资源id基址，据此无需请求X server即可判断窗口是否由此连接创建
+    bool ownsSettingsWindow() const
+    {
+        const xcb_setup_t *setup = xcb_get_setup(connection);
+        return setup && (x_settings_window & ~setup->resource_id_mask) == setup->resource_id_base;
+    }
+
     void setSettings(const QByteArray &data)
     {
-        DXcbConnectionGrabber connectionGrabber(connection);
-        Q_UNUSED(connectionGrabber)
+        // 数据是通过一次REPLACE请求整体写入的，其它客户端不会读到写入一半的数据。
+        // 窗口属于当前连接时只有自己会写入此属性，无需再grab server阻塞其它客户端
+        std::unique_ptr<DXcbConnectionGrabber> connectionGrabber;
+        if (!ownsSettingsWindow())
+            connectionGrabber.reset(new DXcbConnectionGrabber(connection));
+
         xcb_change_property(connection,
                             XCB_PROP_MODE_REPLACE,
                             x_settings_window,
                             x_settings_atom,
-                            internAtom(connection, "_XSETTINGS_SETTINGS"),
+                            _xsettings_type_atom,
                             8, data.size(), data.constData());
 
         xcb_window_t xsettings_owner = _xsettings_owner;
@@ -309,17 +420,18 @@ public:
          qFromBigEndian<t>(x))
 #define VALIDATE_LENGTH(x)    \
         if ((size_t)xSettings.length() < (offset + local_offset + 12 + x)) { \
-            qWarning("Length %d runs past end of data", x); \
+            qWarning("Length %d runs past end of data", int(x)); \
+            last_settings.clear();                                      \
             return;                                                     \
         }
 
-        serial = ADJUST_BO(byteOrder, qint32, xSettings.mid(4,4).constData());
-        uint number_of_settings = ADJUST_BO(byteOrder, quint32, xSettings.mid(8,4).constData());
+        serial = ADJUST_BO(byteOrder, qint32, xSettings.constData() + 4);
+        uint number_of_settings = ADJUST_BO(byteOrder, quint32, xSettings.constData() + 8);
         const char *data = xSettings.constData() + 12;
         size_t offset = 0;
-        // 记录所有设置项的名称
-        QSet<QByteArray> keys;
-        keys.reserve(number_of_settings);
+        // 每次解析使用新的代数标记出现过的设置项，解析结束后未被标记的即为已删除的项
+        const quint32 generation = ++populate_generation;
+        QByteArrayList changed_keys;
 
         for (uint i = 0; i < number_of_settings; i++) {
             int local_offset = 0;
@@ -332,54 +444,174 @@ public:
             local_offset += 2;
 
             VALIDATE_LENGTH(name_len);
-            QByteArray name(data + offset + local_offset, name_len);
+            const char *name_data = data + offset + local_offset;
             local_offset += round_to_nearest_multiple_of_4(name_len);
 
             VALIDATE_LENGTH(4);
             int last_change_serial = ADJUST_BO(byteOrder, qint32, data + offset + local_offset);
-            Q_UNUSED(last_change_serial);
             local_offset += 4;
 
-            QVariant value;
+            // 先只计算值所占的长度，值未变化时无需构造QVariant
+            const int value_offset = local_offset;
             if (type == XSettingsTypeString) {
                 VALIDATE_LENGTH(4);
-                int value_length = ADJUST_BO(byteOrder, qint32, data + offset + local_offset);
-                local_offset+=4;
-                VALIDATE_LENGTH(value_length);
-                QByteArray value_string(data + offset + local_offset, value_length);
-                value.setValue(value_string);
-                local_offset += round_to_nearest_multiple_of_4(value_length);
+                quint32 value_length = ADJUST_BO(byteOrder, quint32, data + offset + local_offset);
+                VALIDATE_LENGTH(4 + size_t(value_length));
+                local_offset += 4 + round_to_nearest_multiple_of_4(value_length);
             } else if (type == XSettingsTypeInteger) {
                 VALIDATE_LENGTH(4);
-                int value_length = ADJUST_BO(byteOrder, qint32, data + offset + local_offset);
                 local_offset += 4;
-                value.setValue(value_length);
             } else if (type == XSettingsTypeColor) {
                 VALIDATE_LENGTH(2*4);
-                quint16 red = ADJUST_BO(byteOrder, quint16, data + offset + local_offset);
-                local_offset += 2;
-                quint16 green = ADJUST_BO(byteOrder, quint16, data + offset + local_offset);
-                local_offset += 2;
-                quint16 blue = ADJUST_BO(byteOrder, quint16, data + offset + local_offset);
-                local_offset += 2;
-                quint16 alpha= ADJUST_BO(byteOrder, quint16, data + offset + local_offset);
-                local_offset += 2;
+                local_offset += 2*4;
+            }
+
+            const char *entry_data = data + offset;
+            const int entry_offset = int(entry_data - xSettings.constData());
+            const int entry_length = local_offset;
+            offset += local_offset;
+
+            // 使用不复制数据的QByteArray查找，已存在的设置项不会产生任何内存分配
+            auto it = settings.find(QByteArray::fromRawData(name_data, name_len));
+
+            if (it != settings.end()) {
+                DXcbXSettingsPropertyValue &xvalue = it.value();
+                // 与上一次数据中此设置项的内容完全一致，或者其serial未增加时可直接跳过
+                const bool unchanged = (xvalue.data_offset >= 0
+                                        && xvalue.data_length == entry_length
+                                        && xvalue.data_offset + entry_length <= last_settings.size()
+                                        && memcmp(last_settings.constData() + xvalue.data_offset, entry_data, entry_length) == 0)
+                        || last_change_serial <= xvalue.last_change_serial;
+
+                xvalue.generation = generation;
+                xvalue.data_offset = entry_offset;
+                xvalue.data_length = entry_length;
+
+                if (unchanged)
+                    continue;
+            } else {
+                // 设置项名称只在第一次出现时分配一次，之后通知时都使用此处保存的key
+                it = settings.insert(QByteArray(name_data, name_len), DXcbXSettingsPropertyValue());
+                it.value().generation = generation;
+                it.value().data_offset = entry_offset;
+                it.value().data_length = entry_length;
+            }
+
+            const QByteArray name = it.key();
+            const char *value_data = entry_data + value_offset;
+            QVariant value;
+
+            if (type == XSettingsTypeString) {
+                quint32 value_length = ADJUST_BO(byteOrder, quint32, value_data);
+                value.setValue(QByteArray(value_data + 4, value_length));
+            } else if (type == XSettingsTypeInteger) {
+                value.setValue(int(ADJUST_BO(byteOrder, qint32, value_data)));
+            } else if (type == XSettingsTypeColor) {
+                quint16 red = ADJUST_BO(byteOrder, quint16, value_data);
+                quint16 green = ADJUST_BO(byteOrder, quint16, value_data + 2);
+                quint16 blue = ADJUST_BO(byteOrder, quint16, value_data + 4);
+                quint16 alpha = ADJUST_BO(byteOrder, quint16, value_data + 6);
                 QColor color_value(red,green,blue,alpha);
                 value.setValue(color_value);
             }
-            offset += local_offset;
 
-            updateValue(settings[name], name,value,last_change_serial);
-            keys << name;
+            // 回调中可能会修改settings，因此不能再使用之前的迭代器
+            if (updateValue(it.value(), name, value, last_change_serial))
+                changed_keys << name;
         }
 
-        for (const QByteArray &key : settings.keys()) {
-            if (!keys.contains(key)) {
-                // 通知属性已经无效
-                updateValue(settings[key], key, QVariant(), INT_MAX);
-                // 移除已经被删除的属性
-                settings.remove(key);
-            }
+#undef VALIDATE_LENGTH
+#undef ADJUST_BO
+
+        // 各设置项中记录的偏移都指向此数据，QByteArray是隐式共享的，此处不会复制数据
+        last_settings = xSettings;
+
+        QByteArrayList removed_keys;
+        for (auto it = settings.constBegin(); it != settings.constEnd(); ++it) {
+            if (it.value().generation != generation)
+                removed_keys << it.key();
+        }
+
+        for (const QByteArray &key : removed_keys) {
+            auto it = settings.find(key);
+
+            if (it == settings.end())
+                continue;
+
+            // 通知属性已经无效
+            if (updateValue(it.value(), key, QVariant(), INT_MAX))
+                changed_keys << key;
+            // 移除已经被删除的属性
+            settings.remove(key);
+        }
+
+        notifyChangedKeys(changed_keys);
+    }
+
+    void notifyChangedKeys(const QByteArrayList &keys)
+    {
+        if (keys.isEmpty())
+            return;
+
+        for (const auto &callback : properties_callback_links) {
+            callback.func(connection, keys, callback.handle);
+        }
+    }
+
+    static char nativeByteOrder()
+    {
+        return QSysInfo::ByteOrder == QSysInfo::LittleEndian ? XCB_IMAGE_ORDER_LSB_FIRST : XCB_IMAGE_ORDER_MSB_FIRST;
+    }
+
+    // 按照本机字节序将一个设置项追加到数据末尾
+    static void appendSettingEntry(QByteArray &xSettings, const QByteArray &key, const DXcbXSettingsPropertyValue &value)
+    {
+        char type = XSettingsTypeString;
+        quint16 key_size = key.size();
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        switch (value.value.typeId()) {
+#else
+        switch (value.value.type()) {
+#endif
+        case QMetaType::QColor:
+            type = XSettingsTypeColor;
+            break;
+        case QMetaType::Int:
+        case QMetaType::Bool:
+            type = XSettingsTypeInteger;
+            break;
+        default:
+            break;
+        }
+
+        xSettings.append(type); //type
+        xSettings.append('\0'); //unused
+        xSettings.append((char*)&key_size, 2); //name-len
+        xSettings.append(key.constData(), key_size); //name
+        xSettings.append(3 - (key_size + 3) % 4, '\0'); //4字节对齐
+        xSettings.append((char*)&value.last_change_serial, 4); //last-change-serial
+
+        if (type == XSettingsTypeInteger) {
+            qint32 int_value = value.value.toInt();
+            xSettings.append((char*)&int_value, 4);
+        } else if (type == XSettingsTypeColor) {
+            const QColor &color = qvariant_cast<QColor>(value.value);
+            quint16 red = color.red();
+            quint16 green = color.green();
+            quint16 blue = color.blue();
+            quint16 alpha = color.alpha();
+
+            xSettings.append((char*)&red, 2);
+            xSettings.append((char*)&green, 2);
+            xSettings.append((char*)&blue, 2);
+            xSettings.append((char*)&alpha, 2);
+        } else {
+            const QByteArray &string_data = value.value.toByteArray();
+            quint32 data_size = string_data.size();
+            xSettings.append((char*)&data_size, 4);
+            xSettings.append(string_data);
+            xSettings.append(3 - (string_data.size() + 3) % 4, '\0'); //4字节对齐
         }
     }
 
@@ -388,74 +620,26 @@ public:
         QByteArray xSettings;
         uint number_of_settings = settings.size();
         xSettings.reserve(12 + number_of_settings * 12);
-        char byteOrder = QSysInfo::ByteOrder == QSysInfo::LittleEndian ? XCB_IMAGE_ORDER_LSB_FIRST : XCB_IMAGE_ORDER_MSB_FIRST;
 
-        xSettings.append(byteOrder); //byte-order
+        xSettings.append(nativeByteOrder()); //byte-order
         xSettings.append(3, '\0'); //unused
         xSettings.append((char*)&serial, sizeof(serial)); //SERIAL
         xSettings.append((char*)&number_of_settings, sizeof(number_of_settings)); //N_SETTINGS
         uint number_of_settings_index = xSettings.size() - sizeof(number_of_settings);
-        for (auto i = settings.constBegin(); i != settings.constEnd(); ++i) {
-            const DXcbXSettingsPropertyValue &value = i.value();
+        for (auto i = settings.begin(); i != settings.end(); ++i) {
+            DXcbXSettingsPropertyValue &value = i.value();
 
             // 忽略无效的数据
             if (!value.value.isValid()) {
+                value.data_offset = -1;
                 --number_of_settings;
                 continue;
             }
 
-            char type = XSettingsTypeString;
-            const QByteArray &key = i.key();
-            quint16 key_size = key.size();
-
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-            switch (value.value.typeId()) {
-#else
-            switch (value.value.type()) {
-#endif
-            case QMetaType::QColor:
-                type = XSettingsTypeColor;
-                break;
-            case QMetaType::Int:
-            case QMetaType::Bool:
-                type = XSettingsTypeInteger;
-                break;
-            default:
-                break;
-            }
-
-            xSettings.append(type); //type
-            xSettings.append('\0'); //unused
-            xSettings.append((char*)&key_size, 2); //name-len
-            xSettings.append(key.constData()); //name
-            xSettings.append(3 - (key_size + 3) % 4, '\0'); //4字节对齐
-            xSettings.append((char*)&value.last_change_serial, 4); //last-change-serial
-
-            QByteArray value_data;
-
-            if (type == XSettingsTypeInteger) {
-                qint32 int_value = value.value.toInt();
-                value_data.append((char*)&int_value, 4);
-            } else if (type == XSettingsTypeColor) {
-                const QColor &color = qvariant_cast<QColor>(value.value);
-                quint16 red = color.red();
-                quint16 green = color.green();
-                quint16 blue = color.blue();
-                quint16 alpha = color.alpha();
-
-                value_data.append((char*)&red, 2);
-                value_data.append((char*)&green, 2);
-                value_data.append((char*)&blue, 2);
-                value_data.append((char*)&alpha, 2);
-            } else {
-                const QByteArray &string_data = value.value.toByteArray();
-                quint32 data_size = string_data.size();
-                value_data.append((char*)&data_size, 4);
-                value_data.append(string_data);
-                value_data.append(3 - (string_data.size() + 3) % 4, '\0'); //4字节对齐
-            }
-
-            xSettings.append(value_data);
+            // 记录设置项在数据中的位置，之后值的长度不变时可以直接在原数据上修改
+            value.data_offset = xSettings.size();
+            appendSettingEntry(xSettings, i.key(), value);
+            value.data_length = xSettings.size() - value.data_offset;
         }
 
         if (number_of_settings == 0) {
@@ -466,10 +650,69 @@ public:
         return xSettings;
     }
 
+    // 只有值发生变化且编码后长度不变时，直接在上一次的数据中替换这些设置项，无需重新序列化所有设置项
+    bool patchSettings(const QByteArrayList &keys, QByteArray *xSettings)
+    {
+        if (last_settings.size() < 12 || last_settings.at(0) != nativeByteOrder())
+            return false;
+
+        QByteArray data = last_settings;
+        QByteArray entry;
+
+        for (const QByteArray &key : keys) {
+            auto it = settings.constFind(key);
+
+            // 新增或者移除了设置项
+            if (it == settings.constEnd() || !it.value().value.isValid() || it.value().data_offset < 0)
+                return false;
+
+            const DXcbXSettingsPropertyValue &value = it.value();
+            entry.resize(0);
+            appendSettingEntry(entry, key, value);
+
+            if (entry.size() != value.data_length || value.data_offset + entry.size() > data.size())
+                return false;
+
+            memcpy(data.data() + value.data_offset, entry.constData(), entry.size());
+        }
+
+        memcpy(data.data() + 4, &serial, sizeof(serial)); //SERIAL
+        *xSettings = data;
+
+        return true;
+    }
+
+    void markSettingChanged(const QByteArray &key)
+    {
+        if (!changed_settings.contains(key))
+            changed_settings << key;
+
+        if (transaction_depth == 0)
+            commitSettings();
+    }
+
+    // 将所有未写入的修改一次性写入窗口属性
+    void commitSettings()
+    {
+        if (changed_settings.isEmpty())
+            return;
+
+        ++serial;
+
+        QByteArray xSettings;
+        if (!patchSettings(changed_settings, &xSettings))
+            xSettings = depopulateSettings();
+
+        changed_settings.clear();
+        // 各设置项中记录的偏移都指向此数据，收到此次修改引起的属性变化时可直接跳过未变化的项
+        last_settings = xSettings;
+        setSettings(xSettings);
+    }
+
     void init(xcb_window_t setting_window, DXcbXSettings *object)
     {
         x_settings_window = setting_window;
-        mapped.insert(x_settings_window, object);
+        addMapped(object);
         initialized = true;
 
         populateSettings(getSettings());
@@ -497,7 +740,14 @@ public:
     xcb_atom_t x_settings_atom;
     qint32 serial = -1;
     QHash<QByteArray, DXcbXSettingsPropertyValue> settings;
+    // 最近一次解析的原始数据
+    QByteArray last_settings;
+    quint32 populate_generation = 0;
+    // 事务中已修改但还未写入窗口属性的设置项
+    QByteArrayList changed_settings;
+    int transaction_depth = 0;
     std::vector<DXcbXSettingsCallback> callback_links;
+    std::vector<DXcbXSettingsPropertiesCallback> properties_callback_links;
     std::vector<DXcbXSettingsSignalCallback> signal_callback_links;
     bool initialized;
 
@@ -506,13 +756,84 @@ public:
     static xcb_atom_t _xsettings_notify_atom;
     // 用于实现信号通知
     static xcb_atom_t _xsettings_signal_atom;
-    static QMultiHash<xcb_window_t, DXcbXSettings*> mapped;
+    // xsettings数据的属性类型
+    static xcb_atom_t _xsettings_type_atom;
+    // 以(窗口, 属性)为key，事件到来时可直接找到关心此属性的设置对象
+    static QMultiHash<quint64, DXcbXSettings*> mapped;
+    // 所有设置对象监听的属性按atom取模后的位掩码，用于快速过滤无关的属性变化事件
+    static quint64 mapped_atom_filter;
+
+    // 大多数情况下一个(窗口, 属性)只对应一个设置对象，使用栈上的数组避免内存分配
+    typedef QVarLengthArray<DXcbXSettings*, 4> SettingsList;
+
+    static quint64 mappedKey(xcb_window_t window, xcb_atom_t atom)
+    {
+        return (quint64(window) << 32) | atom;
+    }
+
+    static quint64 atomFilterBit(xcb_atom_t atom)
+    {
+        return quint64(1) << (atom % 64);
+    }
+
+    static bool mayBeMappedAtom(xcb_atom_t atom)
+    {
+        return mapped_atom_filter & atomFilterBit(atom);
+    }
+
+    static void addMapped(DXcbXSettings *object)
+    {
+        const DXcbXSettingsPrivate *d = object->d_ptr;
+        mapped.insert(mappedKey(d->x_settings_window, d->x_settings_atom), object);
+        mapped_atom_filter |= atomFilterBit(d->x_settings_atom);
+    }
+
+    static void removeMapped(DXcbXSettings *object)
+    {
+        const DXcbXSettingsPrivate *d = object->d_ptr;
+        mapped.remove(mappedKey(d->x_settings_window, d->x_settings_atom), object);
+
+        // 对象销毁的频率很低，直接重新计算过滤掩码
+        mapped_atom_filter = 0;
+        for (auto it = mapped.constBegin(); it != mapped.constEnd(); ++it)
+            mapped_atom_filter |= atomFilterBit(quint32(it.key()));
+    }
+
+    // 回调中可能会创建或者销毁设置对象，因此先将找到的对象复制出来再使用
+    static SettingsList findMapped(xcb_window_t window, xcb_atom_t atom)
+    {
+        SettingsList list;
+
+        if (!mayBeMappedAtom(atom))
+            return list;
+
+        const quint64 key = mappedKey(window, atom);
+        for (auto it = mapped.constFind(key); it != mapped.constEnd() && it.key() == key; ++it)
+            list.append(it.value());
+
+        return list;
+    }
+
+    // window为0时返回所有的设置对象
+    static SettingsList findMappedForWindow(xcb_window_t window)
+    {
+        SettingsList list;
+
+        for (auto it = mapped.constBegin(); it != mapped.constEnd(); ++it) {
+            if (!window || it.value()->d_ptr->x_settings_window == window)
+                list.append(it.value());
+        }
+
+        return list;
+    }
 };
 
 xcb_atom_t DXcbXSettingsPrivate::_xsettings_notify_atom = 0;
 xcb_atom_t DXcbXSettingsPrivate::_xsettings_signal_atom = 0;
+xcb_atom_t DXcbXSettingsPrivate::_xsettings_type_atom = 0;
 xcb_window_t DXcbXSettingsPrivate::_xsettings_owner = 0;
-QMultiHash<xcb_window_t, DXcbXSettings*> DXcbXSettingsPrivate::mapped;
+QMultiHash<quint64, DXcbXSettings*> DXcbXSettingsPrivate::mapped;
+quint64 DXcbXSettingsPrivate::mapped_atom_filter = 0;
 
 DXcbXSettings::DXcbXSettings(xcb_connection_t *connection, const QByteArray &property)
     : DXcbXSettings(connection, 0, property)
@@ -538,7 +859,7 @@ DXcbXSettings::DXcbXSettings(xcb_window_t setting_window, const QByteArray &prop
 
 DXcbXSettings::~DXcbXSettings()
 {
-    DXcbXSettingsPrivate::mapped.remove(d_ptr->x_settings_window, this);
+    DXcbXSettingsPrivate::removeMapped(this);
     delete d_ptr;
     d_ptr = 0;
 }
@@ -566,18 +887,18 @@ xcb_window_t DXcbXSettings::getOwner(xcb_connection_t *conn, int screenNumber)
 
     QByteArray settings_atom_for_screen("_XSETTINGS_S");
     settings_atom_for_screen.append(QByteArray::number(screenNumber));
-    auto atom_reply = Q_XCB_REPLY(xcb_intern_atom,
-                                  conn,
-                                  true,
-                                  settings_atom_for_screen.length(),
-                                  settings_atom_for_screen.constData());
+    auto atom_reply = D_XCB_ROUNDTRIP(Q_XCB_REPLY(xcb_intern_atom,
+                                                  conn,
+                                                  true,
+                                                  settings_atom_for_screen.length(),
+                                                  settings_atom_for_screen.constData()));
     if (!atom_reply)
         return XCB_NONE;
 
     xcb_atom_t selection_owner_atom = atom_reply->atom;
 
-    auto selection_result = Q_XCB_REPLY(xcb_get_selection_owner,
-                                        conn, selection_owner_atom);
+    auto selection_result = D_XCB_ROUNDTRIP(Q_XCB_REPLY(xcb_get_selection_owner,
+                                                        conn, selection_owner_atom));
     if (!selection_result)
         return XCB_NONE;
 
@@ -605,47 +926,46 @@ bool DXcbXSettings::contains(const QByteArray &property) const
 bool DXcbXSettings::handlePropertyNotifyEvent(const xcb_property_notify_event_t *event)
 {
     // 其它窗口的xsettings属性变化是通过client message通知的
-    if (event->window != DXcbXSettingsPrivate::_xsettings_owner) {
+    if (event->window != DXcbXSettingsPrivate::_xsettings_owner
+            || !DXcbXSettingsPrivate::mayBeMappedAtom(event->atom)) {
         return false;
     }
 
-    auto self_list = DXcbXSettingsPrivate::mapped.values(event->window);
+    const auto self_list = DXcbXSettingsPrivate::findMapped(event->window, event->atom);
 
     if (self_list.isEmpty())
         return false;
 
-    for (DXcbXSettings *self : self_list) {
-        // 另外需要判断此对象的设置是监听的哪个窗口属性
-        if (event->atom == self->d_ptr->x_settings_atom)
-            self->d_ptr->populateSettings(self->d_ptr->getSettings());
-    }
+    D_XCB_ROUNDTRIP_OPERATION("settings change");
+
+    for (DXcbXSettings *self : self_list)
+        self->d_ptr->populateSettings(self->d_ptr->getSettings());
 
     return true;
 }
 
 bool DXcbXSettings::handleClientMessageEvent(const xcb_client_message_event_t *event)
 {
+    D_XCB_ROUNDTRIP_OPERATION("settings change");
+
     if (event->format != 32)
         return false;
 
     if (event->type == DXcbXSettingsPrivate::_xsettings_notify_atom) {
-        // data32[0]为属性变化的窗口
-        auto self_list = DXcbXSettingsPrivate::mapped.values(event->data.data32[0]);
+        // data32[0]为属性变化的窗口, data32[1]为变化的属性类型
+        const auto self_list = DXcbXSettingsPrivate::findMapped(event->data.data32[0], event->data.data32[1]);
 
         if (self_list.isEmpty())
             return false;
 
-        for (DXcbXSettings *self : self_list) {
-            // data32[1]为变化的属性类型
-            if (self->d_ptr->x_settings_atom == event->data.data32[1])
-                self->d_ptr->populateSettings(self->d_ptr->getSettings());
-        }
+        for (DXcbXSettings *self : self_list)
+            self->d_ptr->populateSettings(self->d_ptr->getSettings());
 
         return true;
     } else if ( event->type == DXcbXSettingsPrivate::_xsettings_signal_atom) {
         // data32[0]为属性变化的窗口
         xcb_window_t window = event->data.data32[0];
-        auto self_list = window ? DXcbXSettingsPrivate::mapped.values(window) : DXcbXSettingsPrivate::mapped.values();
+        const auto self_list = DXcbXSettingsPrivate::findMappedForWindow(window);
 
         if (self_list.isEmpty())
             return false;
@@ -680,7 +1000,13 @@ bool DXcbXSettings::handleClientMessageEvent(const xcb_client_message_event_t *e
 
 void DXcbXSettings::clearSettings(xcb_window_t setting_window)
 {
-    if (DXcbXSettings *self = DXcbXSettingsPrivate::mapped.value(setting_window)) {
+    if (!setting_window)
+        return;
+
+    const auto self_list = DXcbXSettingsPrivate::findMappedForWindow(setting_window);
+
+    if (!self_list.isEmpty()) {
+        DXcbXSettings *self = self_list.first();
         xcb_delete_property(self->d_ptr->connection, setting_window, self->d_ptr->x_settings_atom);
     }
 }
@@ -712,7 +1038,21 @@ void DXcbXSettings::removeCallbackForHandle(void *handle)
     }
 
     auto isCallbackForHandle = [handle](const DXcbXSettingsCallback &cb) { return cb.handle == handle; };
-    d->callback_links.erase(std::remove_if(d->callback_links.begin(), d->callback_links.end(), isCallbackForHandle));
+    d->callback_links.erase(std::remove_if(d->callback_links.begin(), d->callback_links.end(),
+                                           isCallbackForHandle),
+                            d->callback_links.end());
+
+    auto isPropertiesCallbackForHandle = [handle](const DXcbXSettingsPropertiesCallback &cb) { return cb.handle == handle; };
+    d->properties_callback_links.erase(std::remove_if(d->properties_callback_links.begin(), d->properties_callback_links.end(),
+                                                      isPropertiesCallbackForHandle),
+                                       d->properties_callback_links.end());
+}
+
+void DXcbXSettings::registerPropertiesCallback(DXcbXSettings::PropertiesChangeFunc func, void *handle)
+{
+    Q_D(DXcbXSettings);
+    DXcbXSettingsPropertiesCallback callback = { func, handle };
+    d->properties_callback_links.push_back(callback);
 }
 
 void DXcbXSettings::registerSignalCallback(DXcbXSettings::SignalFunc func, void *handle)
@@ -726,7 +1066,9 @@ void DXcbXSettings::removeSignalCallback(void *handle)
 {
     Q_D(DXcbXSettings);
     auto isCallbackForHandle = [handle](const DXcbXSettingsSignalCallback &cb) { return cb.handle == handle; };
-    d->signal_callback_links.erase(std::remove_if(d->signal_callback_links.begin(), d->signal_callback_links.end(), isCallbackForHandle));
+    d->signal_callback_links.erase(std::remove_if(d->signal_callback_links.begin(), d->signal_callback_links.end(),
+                                                  isCallbackForHandle),
+                                   d->signal_callback_links.end());
 }
 
 void DXcbXSettings::emitSignal(const QByteArray &signal, qint32 data1, qint32 data2)
@@ -781,6 +1123,8 @@ QVariant DXcbXSettings::setting(const QByteArray &property) const
 
 void DXcbXSettings::setSetting(const QByteArray &property, const QVariant &value)
 {
+    D_XCB_ROUNDTRIP_OPERATION("settings change");
+
     Q_D(DXcbXSettings);
 
     DXcbXSettingsPropertyValue &xvalue = d->settings[property];
@@ -788,16 +1132,35 @@ void DXcbXSettings::setSetting(const QByteArray &property, const QVariant &value
     if (xvalue.value == value)
         return;
 
-    d->updateValue(xvalue, property, value, xvalue.last_change_serial + 1);
+    if (d->updateValue(xvalue, property, value, xvalue.last_change_serial + 1))
+        d->notifyChangedKeys({property});
 
     // 移除无效的属性
     if (!value.isValid()) {
         d->settings.remove(property);
     }
 
-    ++d->serial;
-    // 更新属性
-    d->setSettings(d->depopulateSettings());
+    // 更新属性，在事务中时会等到提交事务时才写入
+    d->markSettingChanged(property);
+}
+
+void DXcbXSettings::beginSettingsTransaction()
+{
+    Q_D(DXcbXSettings);
+    ++d->transaction_depth;
+}
+
+void DXcbXSettings::commitSettingsTransaction()
+{
+    D_XCB_ROUNDTRIP_OPERATION("settings change");
+
+    Q_D(DXcbXSettings);
+    Q_ASSERT(d->transaction_depth > 0);
+
+    if (d->transaction_depth > 0 && --d->transaction_depth > 0)
+        return;
+
+    d->commitSettings();
 }
 
 QByteArrayList DXcbXSettings::settingKeys() const
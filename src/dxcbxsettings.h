@@ -38,12 +38,18 @@ public:
     QVariant setting(const QByteArray &property) const override;
     void setSetting(const QByteArray &property, const QVariant &value) override;
     QByteArrayList settingKeys() const override;
+    // 在事务中调用setSetting只会更新本地的值，提交事务时所有修改会在一次写入中完成，事务可以嵌套
+    void beginSettingsTransaction() override;
+    void commitSettingsTransaction() override;
 
     typedef void (*PropertyChangeFunc)(xcb_connection_t *connection, const QByteArray &name, const QVariant &property, void *handle);
     void registerCallback(PropertyChangeFunc func, void *handle);
     void registerCallbackForProperty(const QByteArray &property, PropertyChangeFunc func, void *handle);
     void removeCallbackForHandle(const QByteArray &property, void *handle);
     void removeCallbackForHandle(void *handle);
+    // 一次数据更新中所有发生变化的设置项会在同一次回调中通知
+    typedef void (*PropertiesChangeFunc)(xcb_connection_t *connection, const QByteArrayList &names, void *handle);
+    void registerPropertiesCallback(PropertiesChangeFunc func, void *handle);
     typedef void (*SignalFunc)(xcb_connection_t *connection, const QByteArray &signal, qint32 data1, qint32 data2, void *handle);
     void registerSignalCallback(SignalFunc func, void *handle);
     void removeSignalCallback(void *handle);
@@ -107,6 +107,7 @@ DEFINE_CONST_CHAR(supportForSplittingWindow);
 DEFINE_CONST_CHAR(sendEndStartupNotifition);
 DEFINE_CONST_CHAR(splitWindowOnScreenByType);
 DEFINE_CONST_CHAR(supportForSplittingWindowByType);
+DEFINE_CONST_CHAR(xcbRoundTripStatistics);
 
 // others
 DEFINE_CONST_CHAR(WmWindowTypes);
@@ -5,7 +5,9 @@
 #include "vtablehook.h"
 
 #include <QFileInfo>
+#include <QVarLengthArray>
 #include <algorithm>
+#include <vector>
 
 #ifdef Q_OS_LINUX
 #include <sys/mman.h>
@@ -24,16 +26,117 @@ DPP_BEGIN_NAMESPACE
 QMap<quintptr**, quintptr*> VtableHook::objToOriginalVfptr;
 QMap<const void*, quintptr*> VtableHook::objToGhostVfptr;
 QMap<const void*, quintptr> VtableHook::objDestructFun;
+QHash<const quintptr*, VtableHook::GhostVtable*> VtableHook::ghostVtables;
+QMultiHash<const quintptr*, VtableHook::GhostVtable*> VtableHook::originalToGhostVtables;
+QHash<const quintptr*, int> VtableHook::vtableSizes;
+QHash<const quintptr*, int> VtableHook::destructFunIndexes;
 static std::once_flag exitFlag;
+// 修改对象虚表时使用的临时副本, 避免每次修改都分配内存
+static std::vector<quintptr> editingVtable;
 
-bool VtableHook::copyVtable(quintptr **obj)
+/*!
+ * \brief 同一个类且覆盖了相同虚函数的对象共享同一个虚表
+ */
+struct VtableHook::GhostVtable
+{
+    // 虚表起始地址(offset_to_top)
+    quintptr *table;
+    // 原虚表的入口
+    quintptr *original;
+    int size;
+    int ref;
+};
+
+/*!
+ * \brief 返回对象虚表的大小, 结果会按虚表缓存, 避免每次都重新扫描
+ * \param obj
+ * \return
+ */
+int VtableHook::vtableSize(quintptr **obj)
+{
+    const quintptr *vtable = *obj;
+
+    if (const GhostVtable *ghost = ghostVtables.value(adjustToTop(vtable)))
+        return ghost->size;
+
+    auto it = vtableSizes.constFind(vtable);
+
+    if (it != vtableSizes.constEnd())
+        return it.value();
+
+    int size = getVtableSize(obj);
+    vtableSizes.insert(vtable, size);
+
+    return size;
+}
+
+VtableHook::GhostVtable *VtableHook::findGhostVtable(const quintptr *original, const quintptr *content, int size)
 {
-    int vtable_size = getVtableSize(obj);
+    for (auto it = originalToGhostVtables.constFind(original);
+         it != originalToGhostVtables.constEnd() && it.key() == original; ++it) {
+        GhostVtable *ghost = it.value();
+
+        if (ghost->size == size && memcmp(ghost->table, content, (size + 2) * sizeof(quintptr)) == 0)
+            return ghost;
+    }
+
+    return nullptr;
+}
+
+/*!
+ * \brief 获取内容与content相同的虚表, 不存在时创建一个新的虚表
+ * \param original 对象原本的虚表入口
+ * \param content 虚表内容, 从offset_to_top开始, 共size + 2个元素
+ * \param size
+ * \return 虚表起始地址
+ */
+quintptr *VtableHook::acquireGhostVtable(quintptr *original, const quintptr *content, int size)
+{
+    if (GhostVtable *ghost = findGhostVtable(original, content, size)) {
+        ++ghost->ref;
+
+        return ghost->table;
+    }
+
+    quintptr *table = new quintptr[size + 2];
+    memcpy(table, content, (size + 2) * sizeof(quintptr));
+
+    GhostVtable *ghost = new GhostVtable { table, original, size, 1 };
+    ghostVtables.insert(table, ghost);
+    originalToGhostVtables.insert(original, ghost);
+
+    return table;
+}
+
+void VtableHook::releaseGhostVtable(quintptr *table)
+{
+    GhostVtable *ghost = ghostVtables.value(table);
+
+    if (!ghost || --ghost->ref > 0)
+        return;
+
+    ghostVtables.remove(table);
+
+    for (auto it = originalToGhostVtables.find(ghost->original);
+         it != originalToGhostVtables.end() && it.key() == ghost->original; ++it) {
+        if (it.value() == ghost) {
+            originalToGhostVtables.erase(it);
+            break;
+        }
+    }
+
+    delete[] table;
+    delete ghost;
+}
+
+bool VtableHook::copyVtable(quintptr **obj, int destructFunIndex)
+{
+    int vtable_size = vtableSize(obj);
 
     if (vtable_size == 0)
         return false;
 
-// 多开辟一个元素, 新的虚表结构如下:
+    // 多开辟一个元素, 新的虚表结构如下:
     // 假设原虚表内存布局如下(考虑多继承):
     //                                             C Vtable (7 entities)
     //                                             +--------------------+
@@ -72,19 +175,82 @@ bool VtableHook::copyVtable(quintptr **obj)
     //                                                                          |    +--------------------+
     //                                                                          +----|   original entry  |
     //                                                                               +--------------------+
-    quintptr *new_vtable = new quintptr[vtable_size + 2];
+    // 内容相同的虚表只保留一份, 由所有相同类型且覆盖了相同虚函数的对象共享
+    QVarLengthArray<quintptr, 256> new_vtable(vtable_size + 2);
 
-    memcpy(new_vtable, adjustToTop(*obj), vtable_size * sizeof(quintptr));
+    memcpy(new_vtable.data(), adjustToTop(*obj), vtable_size * sizeof(quintptr));
     new_vtable[vtable_size] = 0;
+    // 存储对象原虚表入口地址
+    new_vtable[vtable_size + 1] = quintptr(*obj);
+    // 覆盖析构函数, 用于在对象析构时自动清理虚表
+    adjustToEntry(new_vtable.data())[destructFunIndex] = reinterpret_cast<quintptr>(&autoCleanVtable);
+
+    quintptr *table = acquireGhostVtable(*obj, new_vtable.constData(), vtable_size);
 
     //! save original vfptr
     objToOriginalVfptr[obj] = *obj;
-    // 存储对象原虚表入口地址
-    new_vtable[vtable_size + 1] = quintptr(*obj);
 
-    *obj = adjustToEntry(new_vtable);
+    *obj = adjustToEntry(table);
     //! save ghost vfptr
-    objToGhostVfptr[obj] = new_vtable;
+    objToGhostVfptr[obj] = table;
+
+    return true;
+}
+
+/*!
+ * \brief 返回obj对象虚表的一个可修改的副本(虚表入口地址), 修改完成后需要调用commitVtable
+ * \param obj
+ * \return
+ */
+quintptr *VtableHook::beginEditVtable(const void *obj)
+{
+    const GhostVtable *ghost = ghostVtables.value(objToGhostVfptr.value(obj));
+
+    if (!ghost)
+        return nullptr;
+
+    editingVtable.assign(ghost->table, ghost->table + ghost->size + 2);
+
+    return adjustToEntry(editingVtable.data());
+}
+
+/*!
+ * \brief 将beginEditVtable返回的副本应用到obj对象
+ * 如果已存在内容相同的虚表则直接共享, 当前虚表只被此对象使用时原地修改, 否则创建新的虚表
+ * \param obj
+ * \return
+ */
+bool VtableHook::commitVtable(const void *obj)
+{
+    quintptr **_obj = (quintptr**)obj;
+    quintptr *current = objToGhostVfptr.value(obj);
+    GhostVtable *ghost = ghostVtables.value(current);
+
+    if (!ghost || editingVtable.size() != size_t(ghost->size + 2))
+        return false;
+
+    const size_t length = editingVtable.size() * sizeof(quintptr);
+
+    if (memcmp(current, editingVtable.data(), length) == 0)
+        return true;
+
+    quintptr *table = nullptr;
+
+    if (GhostVtable *same = findGhostVtable(ghost->original, editingVtable.data(), ghost->size)) {
+        ++same->ref;
+        table = same->table;
+    } else if (ghost->ref == 1) {
+        memcpy(current, editingVtable.data(), length);
+
+        return true;
+    } else {
+        table = acquireGhostVtable(ghost->original, editingVtable.data(), ghost->size);
+    }
+
+    releaseGhostVtable(current);
+
+    *_obj = adjustToEntry(table);
+    objToGhostVfptr[obj] = table;
 
     return true;
 }
@@ -98,7 +264,7 @@ bool VtableHook::clearGhostVtable(const void *obj)
     quintptr *vtable = objToGhostVfptr.take(obj);
 
     if (vtable) {
-        delete[] vtable;
+        releaseGhostVtable(vtable);
 
         return true;
     }
@@ -144,7 +310,7 @@ int VtableHook::getDestructFunIndex(quintptr **obj, std::function<void(void)> de
     };
 
     quintptr *vtable = *obj;
-    int vtable_size = getVtableSize(obj);
+    int vtable_size = vtableSize(obj);
 
     if (vtable_size == 0)
         return -1;
@@ -209,24 +375,31 @@ bool VtableHook::ensureVtable(const void *obj, std::function<void ()> destoryObj
         }
     }
 
-    if (!copyVtable(_obj))
-        return false;
+    quintptr *original = *_obj;
+    auto index_it = destructFunIndexes.constFind(original);
+    int index = -1;
 
-    // 查找对象的析构函数
-    int index = getDestructFunIndex(_obj, destoryObjFun);
+    // 析构函数的位置只与类型有关, 每个类型只需查找一次
+    if (index_it != destructFunIndexes.constEnd()) {
+        index = index_it.value();
+    } else {
+        // 查找对象的析构函数
+        index = getDestructFunIndex(_obj, destoryObjFun);
+
+        // 虚析构函数查找失败
+        if (index < 0) {
+            qCWarning(vtableHook) << "Failed do override destruct function: " << obj;
+            abort();
+        }
 
-    // 虚析构函数查找失败
-    if (index < 0) {
-        qCWarning(vtableHook) << "Failed do override destruct function: " << obj;
-        abort();
+        destructFunIndexes.insert(original, index);
     }
 
-    quintptr *new_vtable = *_obj;
-    // 保存对象真实的析构函数
-    objDestructFun[(void*)obj] = new_vtable[index];
+    if (!copyVtable(_obj, index))
+        return false;
 
-    // 覆盖析构函数, 用于在对象析构时自动清理虚表
-    new_vtable[index] = reinterpret_cast<quintptr>(&autoCleanVtable);
+    // 保存对象真实的析构函数
+    objDestructFun[(void*)obj] = original[index];
 
     // TODO: 由于未知原因,有的虚表会自动还原，导致虚析构不能正常HOOK，无法释放new出来的新虚表数组
     // 这里在程序退出时进行统一释放。后面知道详细原因再进行修改。
@@ -266,10 +439,8 @@ bool VtableHook::hasVtable(const void *obj)
 void VtableHook::resetVtable(const void *obj)
 {
     quintptr **_obj = (quintptr**)obj;
-    int vtable_size = getVtableSize(_obj);
     // 获取obj对象原本虚表的入口
-    auto vtableHead = adjustToTop(*_obj);
-    quintptr *vfptr_t2 = (quintptr*)vtableHead[vtable_size + 1]; // _obj - 2 + vtable_size + 1
+    quintptr *vfptr_t2 = objToOriginalVfptr.value(_obj);
 
     if (!vfptr_t2)
         return;
@@ -297,8 +468,15 @@ quintptr VtableHook::resetVfptrFun(const void *obj, quintptr functionOffset)
         return 0;
     }
 
-    // reset to original fun
-    *(vfptr_t1 + functionOffset / sizeof(quintptr)) = origin_fun;
+    if (current_fun == origin_fun)
+        return current_fun;
+
+    // reset to original fun, 虚表可能被其它对象共享, 不能直接修改
+    quintptr *vtable = beginEditVtable(obj);
+    *(vtable + functionOffset / sizeof(quintptr)) = origin_fun;
+
+    if (!commitVtable(obj))
+        return 0;
 
     return current_fun;
 }
@@ -318,9 +496,8 @@ quintptr VtableHook::originalFun(const void *obj, quintptr functionOffset)
     }
 
     Q_CHECK_PTR(_obj);
-    int vtable_size = getVtableSize(_obj);
     // 获取obj对象原本虚表的入口
-    quintptr *vfptr_t2 = (quintptr*)(*_obj)[vtable_size - 1];
+    quintptr *vfptr_t2 = ghostVtables.value(adjustToTop(*_obj))->original;
 
     if (functionOffset > UINT_LEAST16_MAX) {
         qCWarning(vtableHook, "Is not a virtual function, function address: 0X%llx", functionOffset);
@@ -7,6 +7,7 @@
 
 #include <QObject>
 #include <QSet>
+#include <QHash>
 #include <QDebug>
 #include <QLoggingCategory>
 #include "global.h"
@@ -125,10 +126,11 @@ public:
             return false;
         }
 
-        quintptr *vfptr_t1 = getVtableOfObject(t1);
         quintptr *vfptr_t2 = getVtableOfObject(t2);
+        // 虚表可能被多个对象共享, 需要在副本上修改后再应用到对象
+        quintptr *vfptr_t1 = beginEditVtable(t1);
 
-        bool ok = overrideVfptrFun(vfptr_t1, fun1, vfptr_t2, fun2, false);
+        bool ok = overrideVfptrFun(vfptr_t1, fun1, vfptr_t2, fun2, false) && commitVtable(t1);
 
         if (!ok) {
             // 恢复旧环境
@@ -250,7 +252,7 @@ public:
             return false;
         }
 
-        bool ok = overrideVfptrFun(getVtableOfObject(t1), fun1, fun2, false);
+        bool ok = overrideVfptrFun(beginEditVtable(t1), fun1, fun2, false) && commitVtable(t1);
 
         if (!ok) {
             // 恢复旧环境
@@ -297,36 +299,34 @@ public:
     static typename QtPrivate::FunctionPointer<Fun>::ReturnType
     callOriginalFun(typename QtPrivate::FunctionPointer<Fun>::Object *obj, Fun fun, Args&&... args)
     {
-        quintptr fun_offset = toQuintptr(&fun);
-
-        class _ResetVFun
-        {
-        public:
-            ~_ResetVFun() {
-                *(vfptr + offset / sizeof(quintptr)) = oldFun;
-            }
-            quintptr *vfptr = nullptr;
-            quint16 offset = 0;
-            quintptr oldFun = 0;
-        };
-
-        _ResetVFun rvf;
-
-        rvf.vfptr = *(quintptr**)(obj);
-        rvf.offset = fun_offset;
-        rvf.oldFun = resetVfptrFun((void*)obj, fun_offset);
+        quintptr o_fun = originalFun((void*)obj, toQuintptr(&fun));
 
-        if (!rvf.oldFun) {
+        if (!o_fun) {
             qCWarning(vtableHook) << "Reset the function failed, object address:" << static_cast<void *>(obj);
             abort();
         }
 
+        // 虚表可能被多个对象共享, 不能通过临时还原虚表中的函数来调用原函数,
+        // 此处将原函数构造为非虚成员函数指针(函数地址, this偏移为0)直接调用
+        Q_STATIC_ASSERT(sizeof(Fun) == 2 * sizeof(quintptr));
+        const quintptr o_fun_data[2] = { o_fun, 0 };
+        Fun o_fun_ptr;
+        memcpy(&o_fun_ptr, o_fun_data, sizeof(o_fun_ptr));
+
         // call
-        return (obj->*fun)(std::forward<Args>(args)...);
+        return (obj->*o_fun_ptr)(std::forward<Args>(args)...);
     }
 
 private:
-    static bool copyVtable(quintptr **obj);
+    struct GhostVtable;
+
+    static int vtableSize(quintptr **obj);
+    static GhostVtable *findGhostVtable(const quintptr *original, const quintptr *content, int size);
+    static quintptr *acquireGhostVtable(quintptr *original, const quintptr *content, int size);
+    static void releaseGhostVtable(quintptr *table);
+    static quintptr *beginEditVtable(const void *obj);
+    static bool commitVtable(const void *obj);
+    static bool copyVtable(quintptr **obj, int destructFunIndex);
     static bool clearGhostVtable(const void *obj);
     static void clearAllGhostVtable();
 
@@ -354,6 +354,11 @@ private:
     static QMap<quintptr**, quintptr*> objToOriginalVfptr;
     static QMap<const void*, quintptr*> objToGhostVfptr;
     static QMap<const void*, quintptr> objDestructFun;
+    static QHash<const quintptr*, GhostVtable*> ghostVtables;
+    static QMultiHash<const quintptr*, GhostVtable*> originalToGhostVtables;
+    // 按原虚表缓存的虚表大小和析构函数位置
+    static QHash<const quintptr*, int> vtableSizes;
+    static QHash<const quintptr*, int> destructFunIndexes;
 };
 
 DPP_END_NAMESPACE
@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <benchmark/benchmark.h>
+
+#include <QtGlobal>
+
+namespace DBenchmark {
+
+// 进程中malloc/calloc/realloc的调用次数
+quint64 allocationCount();
+// 进程中等待X服务器回复的次数
+quint64 roundTripCount();
+
+/*!
+ * \brief 在作用域结束时将此期间每次迭代的平均内存分配次数和X往返次数写入benchmark的结果
+ */
+class Counters
+{
+public:
+    explicit Counters(benchmark::State &state)
+        : m_state(state)
+        , m_allocations(allocationCount())
+        , m_roundTrips(roundTripCount())
+    {
+    }
+
+    ~Counters()
+    {
+        m_state.counters["allocs"] = benchmark::Counter(double(allocationCount() - m_allocations),
+                                                        benchmark::Counter::kAvgIterations);
+        m_state.counters["roundtrips"] = benchmark::Counter(double(roundTripCount() - m_roundTrips),
+                                                            benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State &m_state;
+    quint64 m_allocations;
+    quint64 m_roundTrips;
+};
+
+}
+
+#endif // BENCHMARK_H
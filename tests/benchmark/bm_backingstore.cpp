@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "benchmark.h"
+#include "global.h"
+
+#include <QBackingStore>
+#include <QPainter>
+#include <QWindow>
+
+DPP_USE_NAMESPACE
+
+/*!
+ * 在窗口的backing store中绘制一块区域并flush，对应窗口每一帧的更新
+ * 使用 QT_SCALE_FACTOR=1.25 运行时可测试分数缩放下的路径
+ */
+static void flushBackingStore(benchmark::State &state, const char *property)
+{
+    QWindow window;
+    window.setProperty(property, true);
+    window.resize(800, 600);
+    window.create();
+
+    QBackingStore store(&window);
+    store.resize(window.size());
+
+    const QRect rect(0, 0, state.range(0), state.range(0));
+    DBenchmark::Counters counters(state);
+
+    for (auto _ : state) {
+        store.beginPaint(rect);
+        QPainter pa(store.paintDevice());
+        pa.fillRect(rect, Qt::red);
+        pa.end();
+        store.endPaint();
+        store.flush(rect);
+    }
+}
+
+// 由 DBackingStoreProxy 代理的backing store
+static void BM_BackingStore_proxyFlush(benchmark::State &state)
+{
+    flushBackingStore(state, "_d_dxcb_overrideBackingStore");
+}
+BENCHMARK(BM_BackingStore_proxyFlush)
+    ->Arg(64)
+    ->Arg(400)
+    ->Unit(benchmark::kMicrosecond);
+
+// 使用dxcb窗口装饰的窗口，绘制内容会被DPlatformBackingStoreHelper处理
+static void BM_BackingStore_dxcbFlush(benchmark::State &state)
+{
+    flushBackingStore(state, useDxcb);
+}
+BENCHMARK(BM_BackingStore_dxcbFlush)
+    ->Arg(64)
+    ->Arg(400)
+    ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,81 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "benchmark.h"
+#include "dplatformintegration.h"
+
+#include <QColor>
+#include <QObject>
+#include <QWindow>
+
+DPP_USE_NAMESPACE
+
+class BenchmarkSettings : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int intValue MEMBER m_intValue NOTIFY intValueChanged)
+    Q_PROPERTY(QString stringValue MEMBER m_stringValue NOTIFY stringValueChanged)
+    Q_PROPERTY(QColor colorValue MEMBER m_colorValue NOTIFY colorValueChanged)
+    Q_PROPERTY(bool boolValue MEMBER m_boolValue NOTIFY boolValueChanged)
+
+public:
+    using QObject::QObject;
+
+Q_SIGNALS:
+    void intValueChanged();
+    void stringValueChanged();
+    void colorValueChanged();
+    void boolValueChanged();
+
+private:
+    int m_intValue = 0;
+    QString m_stringValue;
+    QColor m_colorValue;
+    bool m_boolValue = false;
+};
+
+// 每个使用DNativeSettings的对象创建时都会构建动态的QMetaObject
+static void BM_DNativeSettings_create(benchmark::State &state)
+{
+    // 没有xsettings owner的环境中(如xvfb)需要使用自己的窗口保存设置
+    QWindow window;
+    window.create();
+
+    DBenchmark::Counters counters(state);
+
+    for (auto _ : state) {
+        BenchmarkSettings object;
+        object.setProperty("_d_domain", "/deepin/benchmark");
+
+        if (!DPlatformIntegration::buildNativeSettings(&object, window.winId())) {
+            state.SkipWithError("Failed to build the native settings");
+            break;
+        }
+    }
+}
+BENCHMARK(BM_DNativeSettings_create)->Unit(benchmark::kMicrosecond);
+
+static void BM_DNativeSettings_setProperty(benchmark::State &state)
+{
+    QWindow window;
+    window.create();
+
+    BenchmarkSettings object;
+    object.setProperty("_d_domain", "/deepin/benchmark");
+
+    if (!DPlatformIntegration::buildNativeSettings(&object, window.winId())) {
+        state.SkipWithError("Failed to build the native settings");
+        return;
+    }
+
+    int value = 0;
+    DBenchmark::Counters counters(state);
+
+    for (auto _ : state) {
+        object.setProperty("intValue", ++value);
+    }
+}
+BENCHMARK(BM_DNativeSettings_setProperty)->Unit(benchmark::kMicrosecond);
+
+#include "bm_dnativesettings.moc"
@@ -0,0 +1,141 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "benchmark.h"
+#include "dxcbxsettings.h"
+#include "utility.h"
+
+#include <QColor>
+#include <QSysInfo>
+#include <QWindow>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <private/qtx11extras_p.h>
+#else
+#include <QtX11Extras/QX11Info>
+#endif
+
+DPP_USE_NAMESPACE
+
+static const QByteArray BENCHMARK_PROPERTY("_DEEPIN_BENCHMARK_SETTINGS");
+
+static void fillSettings(DXcbXSettings *settings, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        const QByteArray key = "Benchmark/Key" + QByteArray::number(i);
+
+        switch (i % 3) {
+        case 0:
+            settings->setSetting(key, i);
+            break;
+        case 1:
+            settings->setSetting(key, QByteArray("value-") + QByteArray::number(i));
+            break;
+        default:
+            settings->setSetting(key, QColor(i % 256, 0, 0));
+            break;
+        }
+    }
+}
+
+// 模拟其它程序修改了一个设置项后收到的通知，每次都会重新读取并解析整个属性
+static void BM_DXcbXSettings_parse(benchmark::State &state)
+{
+    QWindow window;
+    window.create();
+
+    xcb_connection_t *connection = QX11Info::connection();
+    DXcbXSettings settings(connection, window.winId(), BENCHMARK_PROPERTY);
+    fillSettings(&settings, state.range(0));
+
+    const xcb_atom_t property = Utility::internAtom(connection, BENCHMARK_PROPERTY);
+    const xcb_atom_t type = Utility::internAtom(connection, "_XSETTINGS_SETTINGS");
+
+    // 读取写入后的原始数据，之后每次迭代直接修改其中Benchmark/Key0的值和serial
+    QByteArray data;
+    {
+        xcb_get_property_reply_t *reply = xcb_get_property_reply(connection,
+                                                                 xcb_get_property(connection, false, window.winId(),
+                                                                                  property, type, 0, UINT32_MAX / 4),
+                                                                 nullptr);
+        if (reply) {
+            data = QByteArray(static_cast<const char *>(xcb_get_property_value(reply)), xcb_get_property_value_length(reply));
+            free(reply);
+        }
+    }
+
+    // 设置项名称按4字节对齐，"Benchmark/Key0"后有两个字节的填充
+    const int name_offset = data.indexOf(QByteArray("Benchmark/Key0\0\0", 16));
+
+    if (data.size() < 12 || data.at(0) != (QSysInfo::ByteOrder == QSysInfo::LittleEndian ? 0 : 1) || name_offset < 0) {
+        state.SkipWithError("Failed to read the settings property");
+        return;
+    }
+
+    qint32 serial = 0;
+    qint32 entry_serial = 0;
+    qint32 value = 0;
+    memcpy(&serial, data.constData() + 4, 4);
+    memcpy(&entry_serial, data.constData() + name_offset + 16, 4);
+    memcpy(&value, data.constData() + name_offset + 20, 4);
+
+    xcb_client_message_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.response_type = XCB_CLIENT_MESSAGE;
+    event.format = 32;
+    event.type = Utility::internAtom(connection, "_XSETTINGS_SETTINGS_NOTIFY");
+    event.data.data32[0] = window.winId();
+    event.data.data32[1] = property;
+
+    DBenchmark::Counters counters(state);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        // serial必须增加，否则未变化的设置项会被直接跳过
+        ++serial;
+        ++entry_serial;
+        ++value;
+        memcpy(data.data() + 4, &serial, 4);
+        memcpy(data.data() + name_offset + 16, &entry_serial, 4);
+        memcpy(data.data() + name_offset + 20, &value, 4);
+        xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window.winId(), property, type,
+                            8, data.size(), data.constData());
+        state.ResumeTiming();
+
+        DXcbXSettings::handleClientMessageEvent(&event);
+    }
+
+    if (settings.setting("Benchmark/Key0").toInt() != value)
+        state.SkipWithError("The changed value was not parsed");
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DXcbXSettings_parse)
+    ->Arg(16)
+    ->Arg(128)
+    ->Arg(512)
+    ->Unit(benchmark::kMicrosecond);
+
+// 修改一个设置项，会序列化所有设置项并写入窗口属性
+static void BM_DXcbXSettings_serialize(benchmark::State &state)
+{
+    QWindow window;
+    window.create();
+
+    DXcbXSettings settings(QX11Info::connection(), window.winId(), BENCHMARK_PROPERTY);
+    fillSettings(&settings, state.range(0));
+
+    int value = 0;
+    DBenchmark::Counters counters(state);
+
+    for (auto _ : state) {
+        settings.setSetting("Benchmark/Key0", ++value);
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DXcbXSettings_serialize)
+    ->Arg(16)
+    ->Arg(128)
+    ->Arg(512)
+    ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,76 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "benchmark.h"
+#include "utility.h"
+
+#include <QPainterPath>
+#include <QPixmap>
+#include <QWindow>
+
+DPP_USE_NAMESPACE
+
+static void BM_Utility_dropShadow(benchmark::State &state)
+{
+    QPixmap pixmap(state.range(0), state.range(0));
+    pixmap.fill(Qt::white);
+    const qreal radius = state.range(1);
+
+    DBenchmark::Counters counters(state);
+
+    for (auto _ : state) {
+        QImage image = Utility::dropShadow(pixmap, radius, QColor(0, 0, 0, 100));
+        benchmark::DoNotOptimize(image);
+    }
+}
+BENCHMARK(BM_Utility_dropShadow)
+    ->Args({200, 10})
+    ->Args({800, 20})
+    ->Args({1920, 40})
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_Utility_setShapePath(benchmark::State &state)
+{
+    QWindow window;
+    window.resize(state.range(0), state.range(0));
+    window.create();
+
+    QPainterPath path;
+    path.addRoundedRect(QRectF(QPointF(0, 0), window.size()), 8, 8);
+
+    DBenchmark::Counters counters(state);
+
+    for (auto _ : state) {
+        Utility::setShapePath(window.winId(), path, false, false);
+    }
+}
+BENCHMARK(BM_Utility_setShapePath)
+    ->Arg(200)
+    ->Arg(800)
+    ->Arg(1920)
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_Utility_blurWindowBackgroundByPaths(benchmark::State &state)
+{
+    QWindow window;
+    window.resize(800, 600);
+    window.create();
+
+    QList<QPainterPath> paths;
+    for (int i = 0; i < state.range(0); ++i) {
+        QPainterPath path;
+        path.addRoundedRect(QRectF(i * 10, i * 10, 400, 300), 8, 8);
+        paths << path;
+    }
+
+    DBenchmark::Counters counters(state);
+
+    for (auto _ : state) {
+        Utility::blurWindowBackgroundByPaths(window.winId(), paths);
+    }
+}
+BENCHMARK(BM_Utility_blurWindowBackgroundByPaths)
+    ->Arg(1)
+    ->Arg(8)
+    ->Unit(benchmark::kMicrosecond);
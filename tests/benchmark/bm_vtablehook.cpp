@@ -0,0 +1,56 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "benchmark.h"
+#include "vtablehook.h"
+
+#include <QEvent>
+#include <QObject>
+
+#include <vector>
+
+DPP_USE_NAMESPACE
+
+static bool objectEvent(QObject *object, QEvent *event)
+{
+    return VtableHook::callOriginalFun(object, &QObject::event, event);
+}
+
+// 同时存在的对象数量，如弹出大量菜单或提示时
+static void BM_VtableHook_overrideVfptrFun(benchmark::State &state)
+{
+    std::vector<QObject*> objects(state.range(0));
+    DBenchmark::Counters counters(state);
+
+    for (auto _ : state) {
+        for (QObject *&object : objects) {
+            object = new QObject;
+            VtableHook::overrideVfptrFun(object, &QObject::event, &objectEvent);
+        }
+
+        for (QObject *object : objects)
+            delete object;
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_VtableHook_overrideVfptrFun)
+    ->Arg(1)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_VtableHook_callOriginalFun(benchmark::State &state)
+{
+    QObject object;
+    VtableHook::overrideVfptrFun(&object, &QObject::event, &objectEvent);
+    QEvent event(QEvent::User);
+
+    DBenchmark::Counters counters(state);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(object.event(&event));
+    }
+}
+BENCHMARK(BM_VtableHook_callOriginalFun);
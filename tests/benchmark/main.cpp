@@ -0,0 +1,120 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "benchmark.h"
+
+#include <QApplication>
+
+#include <atomic>
+#include <dlfcn.h>
+#include <xcb/xcb.h>
+
+static std::atomic<quint64> allocations(0);
+static std::atomic<quint64> roundTrips(0);
+// xcb_request_check内部也会等待回复，避免重复计数
+static thread_local bool inRoundTrip = false;
+
+quint64 DBenchmark::allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+quint64 DBenchmark::roundTripCount()
+{
+    return roundTrips.load(std::memory_order_relaxed);
+}
+
+// 替换glibc的内存分配函数以统计分配次数，实际的分配仍由glibc完成
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+// 所有xcb_*_reply函数最终都会调用xcb_wait_for_reply，在此统计X往返次数
+void *xcb_wait_for_reply(xcb_connection_t *c, unsigned int request, xcb_generic_error_t **e)
+{
+    typedef void *(*Func)(xcb_connection_t *, unsigned int, xcb_generic_error_t **);
+    static Func func = reinterpret_cast<Func>(dlsym(RTLD_NEXT, "xcb_wait_for_reply"));
+
+    if (inRoundTrip)
+        return func(c, request, e);
+
+    inRoundTrip = true;
+    roundTrips.fetch_add(1, std::memory_order_relaxed);
+    void *reply = func(c, request, e);
+    inRoundTrip = false;
+
+    return reply;
+}
+
+void *xcb_wait_for_reply64(xcb_connection_t *c, uint64_t request, xcb_generic_error_t **e)
+{
+    typedef void *(*Func)(xcb_connection_t *, uint64_t, xcb_generic_error_t **);
+    static Func func = reinterpret_cast<Func>(dlsym(RTLD_NEXT, "xcb_wait_for_reply64"));
+
+    if (inRoundTrip)
+        return func(c, request, e);
+
+    inRoundTrip = true;
+    roundTrips.fetch_add(1, std::memory_order_relaxed);
+    void *reply = func(c, request, e);
+    inRoundTrip = false;
+
+    return reply;
+}
+
+xcb_generic_error_t *xcb_request_check(xcb_connection_t *c, xcb_void_cookie_t cookie)
+{
+    typedef xcb_generic_error_t *(*Func)(xcb_connection_t *, xcb_void_cookie_t);
+    static Func func = reinterpret_cast<Func>(dlsym(RTLD_NEXT, "xcb_request_check"));
+
+    if (inRoundTrip)
+        return func(c, cookie);
+
+    inRoundTrip = true;
+    roundTrips.fetch_add(1, std::memory_order_relaxed);
+    xcb_generic_error_t *error = func(c, cookie);
+    inRoundTrip = false;
+
+    return error;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    qputenv("QT_PLUGIN_PATH", PLUGIN_OUTPUT_PATH);
+
+    // 需要在X服务器(如Xvfb)中运行，且使用dxcb插件
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "dxcb");
+
+    QApplication app(argc, argv);
+    ::benchmark::Initialize(&argc, argv);
+
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    ::benchmark::RunSpecifiedBenchmarks();
+    ::benchmark::Shutdown();
+
+    return 0;
+}
@@ -0,0 +1,34 @@
+#!/bin/bash
+
+# SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+#
+# SPDX-License-Identifier: LGPL-3.0-or-later
+
+BENCHMARK_TARGET=bm-platformplugins
+
+SHELL_FOLDER=$(dirname $(readlink -f "$0"))
+
+# project directroy
+SOURCE_DIR=${SHELL_FOLDER}/../../
+BUILD_DIR=${SOURCE_DIR}/build-benchmark
+BENCHMARK_BUILD_DIR=${BUILD_DIR}/tests/benchmark
+XVFB_ARGS="-screen 0 1920x1080x24 +extension GLX +extension Composite"
+
+cd ${SOURCE_DIR}
+
+cmake -B${BUILD_DIR} -DCMAKE_BUILD_TYPE=Release -GNinja -DBUILD_BENCHMARK=ON
+
+cmake --build ${BUILD_DIR} --target ${BENCHMARK_TARGET}
+
+# 使用Mesa llvmpipe软件渲染，保证在不同机器上的结果可以比较
+export LIBGL_ALWAYS_SOFTWARE=1
+export GALLIUM_DRIVER=llvmpipe
+export QT_QPA_PLATFORM=dxcb
+
+xvfb-run -a -s "${XVFB_ARGS}" ${BENCHMARK_BUILD_DIR}/${BENCHMARK_TARGET} \
+    --benchmark_out=${BUILD_DIR}/benchmark.json --benchmark_out_format=json "$@"
+
+# 分数缩放下的backing store
+QT_SCALE_FACTOR=1.25 xvfb-run -a -s "${XVFB_ARGS}" ${BENCHMARK_BUILD_DIR}/${BENCHMARK_TARGET} \
+    --benchmark_filter=BackingStore \
+    --benchmark_out=${BUILD_DIR}/benchmark-scale.json --benchmark_out_format=json "$@"
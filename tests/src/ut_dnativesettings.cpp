@@ -4,11 +4,67 @@
 
 #include <gtest/gtest.h>
 #include <QWindow>
+#include <QMap>
 
 #include "dnativesettings.h"
+#include "dplatformsettings.h"
 
 DPP_USE_NAMESPACE
 
+// 使用内存中的设置项，不依赖X服务器
+class TestPlatformSettings : public DPlatformSettings
+{
+public:
+    bool contains(const QByteArray &property) const override
+    {
+        return values.contains(property);
+    }
+
+    QVariant setting(const QByteArray &property) const override
+    {
+        return values.value(property);
+    }
+
+    void setSetting(const QByteArray &property, const QVariant &value) override
+    {
+        if (value.isValid())
+            values[property] = value;
+        else
+            values.remove(property);
+
+        handlePropertyChanged(property, value);
+    }
+
+    QByteArrayList settingKeys() const override
+    {
+        return values.keys();
+    }
+
+    void emitSignal(const QByteArray &, qint32, qint32) override {}
+
+    QMap<QByteArray, QVariant> values;
+};
+
+class TestSettingsObject : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QBitArray validProperties MEMBER m_validProperties)
+
+public:
+    // 返回的对象跟随此对象销毁
+    DNativeSettings *createSettings(const QByteArrayList &keys)
+    {
+        TestPlatformSettings *settings = new TestPlatformSettings;
+
+        for (const QByteArray &key : keys)
+            settings->values[key] = key;
+
+        return new DNativeSettings(this, settings, false);
+    }
+
+    QBitArray m_validProperties;
+};
+
 class GTEST_API_ TDNativeSettings : public testing::Test
 {
 protected:
@@ -36,4 +92,77 @@ TEST_F(TDNativeSettings, getSettingsProperty)
     ASSERT_EQ(array, "_TEST_TEST");
 }
 
+TEST_F(TDNativeSettings, shareMetaObject)
+{
+    const QByteArrayList keys { "key0", "key1" };
+    TestSettingsObject *obj1 = new TestSettingsObject;
+    TestSettingsObject *obj2 = new TestSettingsObject;
+    DNativeSettings *settings1 = obj1->createSettings(keys);
+    DNativeSettings *settings2 = obj2->createSettings(keys);
+
+    // 相同类型的对象共享同一个元对象
+    DNativeSettingsMeta *meta = settings1->m_meta;
+    ASSERT_TRUE(meta);
+    ASSERT_EQ(meta, settings2->m_meta);
+    ASSERT_EQ(meta->ref, 2);
+
+    // 添加属性时切换到新的元对象，不影响其它对象
+    ASSERT_EQ(obj1->property("key0").toByteArray(), QByteArray("key0"));
+    DNativeSettingsMeta *extended = settings1->m_meta;
+    ASSERT_NE(extended, meta);
+    ASSERT_EQ(settings2->m_meta, meta);
+    ASSERT_EQ(meta->ref, 1);
+    ASSERT_EQ(extended->ref, 1);
+    ASSERT_EQ(extended->extraKeys, keys);
+    ASSERT_EQ(obj1->property("key1").toByteArray(), QByteArray("key1"));
+    ASSERT_FALSE(meta->propertyIndexes.contains("key1"));
+
+    // 添加了相同属性的对象共享扩展后的元对象，不再使用的元对象被释放
+    const QMetaObject *source = meta->source;
+    ASSERT_EQ(obj2->property("key0").toByteArray(), QByteArray("key0"));
+    ASSERT_EQ(settings2->m_meta, extended);
+    ASSERT_EQ(extended->ref, 2);
+    ASSERT_FALSE(DNativeSettingsMeta::sharedMetas.contains(DNativeSettingsMeta::Key(source, QByteArrayList())));
+
+    delete obj1;
+    ASSERT_EQ(extended->ref, 1);
+    ASSERT_EQ(obj2->property("key1").toByteArray(), QByteArray("key1"));
+
+    delete obj2;
+    ASSERT_FALSE(DNativeSettingsMeta::sharedMetas.contains(DNativeSettingsMeta::Key(source, keys)));
+}
+
+TEST_F(TDNativeSettings, validPropertiesBitArray)
+{
+    QByteArrayList keys;
+
+    for (int i = 0; i < 70; ++i)
+        keys << QByteArray("key") + QByteArray::number(i).rightJustified(2, '0');
+
+    TestSettingsObject *obj = new TestSettingsObject;
+    DNativeSettings *settings = obj->createSettings(keys);
+    TestPlatformSettings *platform_settings = static_cast<TestPlatformSettings*>(settings->m_settings);
+
+    // 访问任一设置项时会为所有设置项创建属性
+    ASSERT_EQ(obj->property("key00").toByteArray(), QByteArray("key00"));
+    ASSERT_GT(settings->m_meta->propertyKeys.size(), 64);
+
+    const int index = settings->m_meta->propertyIndexes.value("key69", -1);
+    ASSERT_GE(index, 64);
+
+    // 超过64个属性时QBitArray类型的validProperties依然能记录每个属性的状态
+    platform_settings->setSetting("key69", QVariant());
+    QBitArray valid_properties = obj->property("validProperties").toBitArray();
+    ASSERT_GT(valid_properties.size(), index);
+    ASSERT_FALSE(valid_properties.testBit(index));
+    ASSERT_TRUE(valid_properties.testBit(settings->m_meta->propertyIndexes.value("key68")));
+
+    platform_settings->setSetting("key69", QByteArray("value"));
+    valid_properties = obj->property("validProperties").toBitArray();
+    ASSERT_TRUE(valid_properties.testBit(index));
+    ASSERT_EQ(obj->property("key69").toByteArray(), QByteArray("value"));
+
+    delete obj;
+}
 
+#include "ut_dnativesettings.moc"
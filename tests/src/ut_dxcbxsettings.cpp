@@ -20,6 +20,13 @@ static void propertyChangedfunc(xcb_connection_t *, const QByteArray &, const QV
     testPropertyChangedCallback = true;
 }
 
+static QByteArrayList testChangedKeys;
+
+static void propertiesChangedfunc(xcb_connection_t *, const QByteArrayList &names, void *)
+{
+    testChangedKeys = names;
+}
+
 class GTEST_API_ TDXcbXSettings : public testing::Test
 {
 protected:
@@ -101,3 +108,42 @@ TEST_F(TDXcbXSettings, registerCallbackForProperty)
     ASSERT_TRUE(testPropertyChangedCallback);
     settings->removeCallbackForHandle(TEST_VALUE, (void *)&propertyChangedfunc);
 }
+
+TEST_F(TDXcbXSettings, registerPropertiesCallback)
+{
+    testChangedKeys.clear();
+    settings->registerPropertiesCallback(propertiesChangedfunc, (void *)&propertiesChangedfunc);
+    QVariant oldValue = settings->setting(TEST_VALUE);
+    settings->setSetting(TEST_VALUE, oldValue.toInt() + 1);
+    ASSERT_EQ(testChangedKeys, QByteArrayList{TEST_VALUE});
+    settings->removeCallbackForHandle((void *)&propertiesChangedfunc);
+
+    testChangedKeys.clear();
+    settings->setSetting(TEST_VALUE, oldValue.toInt() + 2);
+    ASSERT_TRUE(testChangedKeys.isEmpty());
+}
+
+TEST_F(TDXcbXSettings, settingsTransaction)
+{
+    static const QByteArray TEST_STRING_VALUE("Test/StringValue");
+
+    settings->beginSettingsTransaction();
+    settings->setSetting(TEST_VALUE, 300);
+    settings->setSetting(TEST_STRING_VALUE, QByteArray("test"));
+    settings->commitSettingsTransaction();
+
+    ASSERT_EQ(settings->setting(TEST_VALUE).toInt(), 300);
+    ASSERT_EQ(settings->setting(TEST_STRING_VALUE).toByteArray(), QByteArray("test"));
+
+    // 长度不变的修改
+    settings->beginSettingsTransaction();
+    settings->setSetting(TEST_VALUE, 301);
+    settings->setSetting(TEST_STRING_VALUE, QByteArray("tset"));
+    settings->commitSettingsTransaction();
+
+    ASSERT_EQ(settings->setting(TEST_VALUE).toInt(), 301);
+    ASSERT_EQ(settings->setting(TEST_STRING_VALUE).toByteArray(), QByteArray("tset"));
+
+    settings->setSetting(TEST_STRING_VALUE, QVariant());
+    ASSERT_FALSE(settings->contains(TEST_STRING_VALUE));
+}
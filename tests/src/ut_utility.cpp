@@ -5,6 +5,8 @@
 #include <gtest/gtest.h>
 #include <QWindow>
 #include <QDebug>
+#include <QPolygon>
+#include <QRegion>
 
 #include "utility.h"
 #include <xcb/xcb.h>
@@ -25,6 +27,25 @@ TEST(TUtility, dropShadow)
     ASSERT_TRUE(image.size() == QSize(100 + 2 * 4, 100 + 2 * 4));
 }
 
+TEST(TUtility, dropShadowWithinPadding)
+{
+    // radius % 3 == 2 时，模糊的扩散范围也不能超出边距，否则阴影会在图片边缘被截断
+    for (qreal radius : {5.0, 8.0, 11.0, 14.0}) {
+        QPixmap pixmap(20, 20);
+        pixmap.fill(Qt::black);
+        QImage image = Utility::dropShadow(pixmap, radius, QColor(0, 0, 0));
+        const int padding = int(radius);
+        ASSERT_TRUE(image.size() == QSize(20 + 2 * padding, 20 + 2 * padding));
+
+        for (int i = 0; i < image.width(); ++i) {
+            ASSERT_EQ(qAlpha(image.pixel(i, 0)), 0);
+            ASSERT_EQ(qAlpha(image.pixel(i, image.height() - 1)), 0);
+            ASSERT_EQ(qAlpha(image.pixel(0, i)), 0);
+            ASSERT_EQ(qAlpha(image.pixel(image.width() - 1, i)), 0);
+        }
+    }
+}
+
 TEST(TUtility, borderImage)
 {
     QPixmap pixmap(100, 100);
@@ -53,3 +74,160 @@ TEST(TUtility, internAtom)
     atom = Utility::internAtom(QX11Info::connection(), "test");
     ASSERT_TRUE(atom == XCB_NONE);
 }
+
+TEST(TUtility, prefetchAtoms)
+{
+    Utility::prefetchAtoms(QX11Info::connection());
+    xcb_atom_t atom = Utility::internAtom("_DEEPIN_FORCE_DECORATE", false);
+    ASSERT_TRUE(atom != XCB_NONE);
+    ASSERT_TRUE(Utility::internAtom("_DEEPIN_FORCE_DECORATE") == atom);
+    ASSERT_TRUE(Utility::internAtom(QX11Info::connection(), "_DEEPIN_FORCE_DECORATE") == atom);
+}
+
+TEST(TUtility, internMissingAtom)
+{
+    const char *name = "_DEEPIN_TEST_MISSING_ATOM";
+    ASSERT_TRUE(Utility::internAtom(name) == XCB_NONE);
+
+    // 模拟其它客户端在之后创建了此atom，不存在的结果不能被缓存
+    xcb_connection_t *connection = QX11Info::connection();
+    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(connection, xcb_intern_atom(connection, false, strlen(name), name), nullptr);
+    ASSERT_TRUE(reply);
+    xcb_atom_t atom = reply->atom;
+    free(reply);
+
+    ASSERT_TRUE(atom != XCB_NONE);
+    ASSERT_TRUE(Utility::internAtom(name) == atom);
+    ASSERT_TRUE(Utility::internAtom(name, false) == atom);
+}
+
+TEST(TUtility, roundedRectShadow)
+{
+    QImage image = Utility::roundedRectShadow(QSize(), 8, 4, QColor(0, 0, 0, 100));
+    ASSERT_TRUE(image.isNull());
+    image = Utility::roundedRectShadow(QSize(200, 100), 8, 12, QColor(0, 0, 0, 100));
+    ASSERT_TRUE(image.size() == QSize(200 + 2 * 12, 100 + 2 * 12));
+    // 第二次调用命中缓存，结果应与第一次一致
+    ASSERT_TRUE(image == Utility::roundedRectShadow(QSize(200, 100), 8, 12, QColor(0, 0, 0, 100)));
+    // 过小的尺寸不会进行九宫格拉伸
+    image = Utility::roundedRectShadow(QSize(10, 10), 8, 12, QColor(0, 0, 0, 100));
+    ASSERT_TRUE(image.size() == QSize(10 + 2 * 12, 10 + 2 * 12));
+}
+
+static QRegion shapeRegion(const QVector<xcb_rectangle_t> &rectangles)
+{
+    QRegion region;
+
+    for (const xcb_rectangle_t &r : rectangles)
+        region += QRect(r.x, r.y, r.width, r.height);
+
+    return region;
+}
+
+static QRegion pathRegion(const QPainterPath &path)
+{
+    return QRegion(path.toFillPolygon().toPolygon(), path.fillRule());
+}
+
+// 向四周扩展一个像素
+static QRegion dilateRegion(const QRegion &region)
+{
+    QRegion result = region;
+
+    for (int dx = -1; dx <= 1; ++dx) {
+        for (int dy = -1; dy <= 1; ++dy)
+            result += region.translated(dx, dy);
+    }
+
+    return result;
+}
+
+// 同一个带内的矩形高度相同且按x排序互不相邻，带之间按y排序互不重叠
+static bool isYXBanded(const QVector<xcb_rectangle_t> &rectangles)
+{
+    for (int i = 1; i < rectangles.size(); ++i) {
+        const xcb_rectangle_t &a = rectangles.at(i - 1);
+        const xcb_rectangle_t &b = rectangles.at(i);
+
+        if (a.y == b.y) {
+            if (a.height != b.height || a.x + a.width >= b.x)
+                return false;
+        } else if (b.y < a.y + a.height) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+TEST(TUtility, shapeRoundedRect)
+{
+    QPainterPath path;
+    path.addRoundedRect(QRectF(10, 10, 200, 100), 8, 8);
+
+    const QVector<xcb_rectangle_t> rectangles = Utility::shapePathRectangles(path);
+    const QRegion region = shapeRegion(rectangles);
+    const QRegion expected = pathRegion(path);
+
+    ASSERT_FALSE(region.isEmpty());
+    ASSERT_TRUE(isYXBanded(rectangles));
+    ASSERT_EQ(region.boundingRect(), expected.boundingRect());
+    // 圆角处曲线被拟合为多边形，允许一个像素的误差
+    ASSERT_TRUE((region - dilateRegion(expected)).isEmpty());
+    ASSERT_TRUE((expected - dilateRegion(region)).isEmpty());
+    // 第二次调用命中缓存
+    ASSERT_TRUE(shapeRegion(Utility::shapePathRectangles(path)) == region);
+}
+
+TEST(TUtility, shapeOddEvenHole)
+{
+    QPainterPath path;
+    path.setFillRule(Qt::OddEvenFill);
+    path.addRect(0, 0, 100, 100);
+    path.addRect(20, 30, 40, 20);
+
+    const QVector<xcb_rectangle_t> rectangles = Utility::shapePathRectangles(path);
+    const QRegion region = shapeRegion(rectangles);
+
+    ASSERT_TRUE(region == pathRegion(path));
+    ASSERT_FALSE(region.contains(QPoint(40, 40)));
+    ASSERT_TRUE(region.contains(QPoint(10, 40)));
+    // 上中下三个带，中间的带被洞分为两个矩形
+    ASSERT_EQ(rectangles.size(), 4);
+    ASSERT_TRUE(isYXBanded(rectangles));
+}
+
+TEST(TUtility, shapeWindingOverlap)
+{
+    QPainterPath path;
+    path.setFillRule(Qt::WindingFill);
+    path.addRect(0, 0, 60, 60);
+    path.addRect(30, 30, 60, 60);
+
+    const QVector<xcb_rectangle_t> rectangles = Utility::shapePathRectangles(path);
+    const QRegion region = shapeRegion(rectangles);
+
+    ASSERT_TRUE(region == pathRegion(path));
+    // 重叠部分的环绕数为2，仍然需要填充
+    ASSERT_TRUE(region.contains(QPoint(45, 45)));
+    ASSERT_TRUE(isYXBanded(rectangles));
+
+    // 自相交的五角星，中心区域的环绕数为2
+    QPainterPath star;
+    star.setFillRule(Qt::WindingFill);
+    star.moveTo(100, 0);
+    star.lineTo(159, 181);
+    star.lineTo(5, 69);
+    star.lineTo(195, 69);
+    star.lineTo(41, 181);
+    star.closeSubpath();
+
+    const QVector<xcb_rectangle_t> star_rectangles = Utility::shapePathRectangles(star);
+    const QRegion star_region = shapeRegion(star_rectangles);
+    const QRegion star_expected = pathRegion(star);
+
+    ASSERT_TRUE(star_region.contains(QPoint(100, 100)));
+    ASSERT_TRUE(isYXBanded(star_rectangles));
+    ASSERT_TRUE((star_region - dilateRegion(star_expected)).isEmpty());
+    ASSERT_TRUE((star_expected - dilateRegion(star_region)).isEmpty());
+}
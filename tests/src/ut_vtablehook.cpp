@@ -0,0 +1,115 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include <gtest/gtest.h>
+
+#include "vtablehook.h"
+
+DPP_USE_NAMESPACE
+
+class TestVtableObject
+{
+public:
+    virtual ~TestVtableObject() {}
+    virtual int value() const { return 1; }
+    virtual int other() const { return 10; }
+};
+
+static int overrideValue(TestVtableObject *)
+{
+    return 2;
+}
+
+static int overrideOther(TestVtableObject *)
+{
+    return 20;
+}
+
+// 阻止编译器根据已知的对象类型去虚拟化调用
+__attribute__((noinline)) static int callValue(TestVtableObject *obj)
+{
+    asm volatile("" : "+r"(obj));
+    return obj->value();
+}
+
+__attribute__((noinline)) static int callOther(TestVtableObject *obj)
+{
+    asm volatile("" : "+r"(obj));
+    return obj->other();
+}
+
+TEST(TVtableHook, shareGhostVtable)
+{
+    TestVtableObject *obj1 = new TestVtableObject;
+    TestVtableObject *obj2 = new TestVtableObject;
+
+    ASSERT_TRUE(VtableHook::overrideVfptrFun(obj1, &TestVtableObject::value, overrideValue));
+    ASSERT_TRUE(VtableHook::overrideVfptrFun(obj2, &TestVtableObject::value, overrideValue));
+    ASSERT_EQ(callValue(obj1), 2);
+    ASSERT_EQ(callValue(obj2), 2);
+
+    // 覆盖了相同函数的对象共享同一个虚表
+    quintptr *table = VtableHook::objToGhostVfptr.value(obj1);
+    ASSERT_TRUE(table);
+    ASSERT_EQ(table, VtableHook::objToGhostVfptr.value(obj2));
+
+    VtableHook::GhostVtable *ghost = VtableHook::ghostVtables.value(table);
+    ASSERT_TRUE(ghost);
+    ASSERT_EQ(ghost->ref, 2);
+
+    // 销毁其中一个对象不影响另一个对象
+    delete obj1;
+    ASSERT_EQ(VtableHook::ghostVtables.value(table), ghost);
+    ASSERT_EQ(ghost->ref, 1);
+    ASSERT_TRUE(VtableHook::hasVtable(obj2));
+    ASSERT_EQ(callValue(obj2), 2);
+
+    // 最后一个对象销毁时释放虚表
+    delete obj2;
+    ASSERT_FALSE(VtableHook::ghostVtables.contains(table));
+}
+
+TEST(TVtableHook, editSharedVtable)
+{
+    TestVtableObject *obj1 = new TestVtableObject;
+    TestVtableObject *obj2 = new TestVtableObject;
+
+    ASSERT_TRUE(VtableHook::overrideVfptrFun(obj1, &TestVtableObject::value, overrideValue));
+    ASSERT_TRUE(VtableHook::overrideVfptrFun(obj2, &TestVtableObject::value, overrideValue));
+    quintptr *shared = VtableHook::objToGhostVfptr.value(obj1);
+
+    // 修改共享虚表的对象会得到新的虚表，其它对象不受影响
+    ASSERT_TRUE(VtableHook::overrideVfptrFun(obj2, &TestVtableObject::other, overrideOther));
+    ASSERT_NE(VtableHook::objToGhostVfptr.value(obj2), shared);
+    ASSERT_EQ(VtableHook::objToGhostVfptr.value(obj1), shared);
+    ASSERT_EQ(VtableHook::ghostVtables.value(shared)->ref, 1);
+    ASSERT_EQ(callOther(obj1), 10);
+    ASSERT_EQ(callOther(obj2), 20);
+    ASSERT_EQ(callValue(obj2), 2);
+
+    // 覆盖相同的函数后再次共享同一个虚表
+    ASSERT_TRUE(VtableHook::overrideVfptrFun(obj1, &TestVtableObject::other, overrideOther));
+    ASSERT_EQ(VtableHook::objToGhostVfptr.value(obj1), VtableHook::objToGhostVfptr.value(obj2));
+    ASSERT_FALSE(VtableHook::ghostVtables.contains(shared));
+
+    delete obj1;
+    delete obj2;
+}
+
+TEST(TVtableHook, callOriginalFun)
+{
+    TestVtableObject *obj = new TestVtableObject;
+
+    ASSERT_TRUE(VtableHook::overrideVfptrFun(obj, &TestVtableObject::value, overrideValue));
+    ASSERT_EQ(callValue(obj), 2);
+    ASSERT_EQ(VtableHook::callOriginalFun(obj, &TestVtableObject::value), 1);
+    // 调用原函数后对象仍然使用覆盖后的函数
+    ASSERT_EQ(callValue(obj), 2);
+
+    VtableHook::resetVtable(obj);
+    ASSERT_FALSE(VtableHook::hasVtable(obj));
+    ASSERT_EQ(callValue(obj), 1);
+
+    delete obj;
+}
@@ -7,6 +7,7 @@
 #include "global.h"
 #include "utility.h"
 #include "dxcbwmsupport.h"
+#include "dxcbroundtrip.h"
 
 #include "qxcbconnection.h"
 #include "qxcbscreen.h"
@@ -76,12 +77,12 @@ QRect DForeignPlatformWindow::geometry() const
 {
     xcb_connection_t *conn = DPlatformIntegration::xcbConnection()->xcb_connection();
 
-    xcbReplyHolder(xcb_get_geometry_reply_t, geomReply)(xcb_get_geometry_reply(conn, xcb_get_geometry(conn, m_window), nullptr));
+    xcbReplyHolder(xcb_get_geometry_reply_t, geomReply)(D_XCB_ROUNDTRIP(xcb_get_geometry_reply(conn, xcb_get_geometry(conn, m_window), nullptr)));
     if (!geomReply)
         return QRect();
 
     auto xtc_cookie = xcb_translate_coordinates(conn, m_window, DPlatformIntegration::xcbConnection()->rootWindow(), 0, 0);
-    xcbReplyHolder(xcb_translate_coordinates_reply_t, translateReply)(xcb_translate_coordinates_reply(conn, xtc_cookie, nullptr));
+    xcbReplyHolder(xcb_translate_coordinates_reply_t, translateReply)(D_XCB_ROUNDTRIP(xcb_translate_coordinates_reply(conn, xtc_cookie, nullptr)));
     if (!translateReply) {
         return QRect();
     }
@@ -91,7 +92,7 @@ QRect DForeignPlatformWindow::geometry() const
     // auto remove _GTK_FRAME_EXTENTS
     xcb_get_property_cookie_t cookie = xcb_get_property(xcb_connection(), false, m_window,
                                                         Utility::internAtom("_GTK_FRAME_EXTENTS"), XCB_ATOM_CARDINAL, 0, 4);
-    xcbReplyHolder(xcb_get_property_reply_t, reply)(xcb_get_property_reply(xcb_connection(), cookie, nullptr));
+    xcbReplyHolder(xcb_get_property_reply_t, reply)(D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection(), cookie, nullptr)));
     if (reply && reply->type == XCB_ATOM_CARDINAL && reply->format == 32 && reply->value_len == 4) {
         quint32 *data = (quint32 *)xcb_get_property_value(reply.data());
         // _NET_FRAME_EXTENTS format is left, right, top, bottom
@@ -107,7 +108,7 @@ QMargins DForeignPlatformWindow::frameMargins() const
     if (m_dirtyFrameMargins) {
         if (DXcbWMSupport::instance()->isSupportedByWM(atom(QXcbAtom::D_QXCBATOM_WRAPPER(_NET_FRAME_EXTENTS)))) {
             xcb_get_property_cookie_t cookie = xcb_get_property(xcb_connection(), false, m_window, atom(QXcbAtom::D_QXCBATOM_WRAPPER(_NET_FRAME_EXTENTS)), XCB_ATOM_CARDINAL, 0, 4);
-            xcb_get_property_reply_t *reply = xcb_get_property_reply(xcb_connection(), cookie, nullptr);
+            xcb_get_property_reply_t *reply = D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection(), cookie, nullptr));
 
             if (reply) {
                 if (reply->type == XCB_ATOM_CARDINAL && reply->format == 32 && reply->value_len == 4) {
@@ -135,7 +136,7 @@ void DForeignPlatformWindow::handleConfigureNotifyEvent(const xcb_configure_noti
         // Do not trust the position, query it instead.
         xcb_translate_coordinates_cookie_t cookie = xcb_translate_coordinates(xcb_connection(), xcb_window(),
                                                                               xcbScreen()->root(), 0, 0);
-        xcb_translate_coordinates_reply_t *reply = xcb_translate_coordinates_reply(xcb_connection(), cookie, NULL);
+        xcb_translate_coordinates_reply_t *reply = D_XCB_ROUNDTRIP(xcb_translate_coordinates_reply(xcb_connection(), cookie, NULL));
         if (reply) {
             pos.setX(reply->dst_x);
             pos.setY(reply->dst_y);
@@ -152,7 +153,7 @@ void DForeignPlatformWindow::handleConfigureNotifyEvent(const xcb_configure_noti
     xcb_get_property_cookie_t cookie = xcb_get_property(xcb_connection(), false, m_window,
                                                         Utility::internAtom("_GTK_FRAME_EXTENTS"), XCB_ATOM_CARDINAL, 0, 4);
     QScopedPointer<xcb_get_property_reply_t, QScopedPointerPodDeleter> reply(
-        xcb_get_property_reply(xcb_connection(), cookie, NULL));
+        D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection(), cookie, NULL)));
     if (reply && reply->type == XCB_ATOM_CARDINAL && reply->format == 32 && reply->value_len == 4) {
         quint32 *data = (quint32 *)xcb_get_property_value(reply.data());
         // _NET_FRAME_EXTENTS format is left, right, top, bottom
@@ -262,10 +263,10 @@ QPlatformScreen *DForeignPlatformWindow::screenForGeometry(const QRect &newGeome
 void DForeignPlatformWindow::updateTitle()
 {
     xcb_get_property_reply_t *wm_name =
-        xcb_get_property_reply(xcb_connection(),
+        D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection(),
             xcb_get_property_unchecked(xcb_connection(), false, m_window,
                              atom(QXcbAtom::D_QXCBATOM_WRAPPER(_NET_WM_NAME)),
-                             atom(QXcbAtom::D_QXCBATOM_WRAPPER(UTF8_STRING)), 0, 1024), NULL);
+                             atom(QXcbAtom::D_QXCBATOM_WRAPPER(UTF8_STRING)), 0, 1024), NULL));
     if (wm_name && wm_name->format == 8
             && wm_name->type == atom(QXcbAtom::D_QXCBATOM_WRAPPER(UTF8_STRING))) {
         const QString &title = QString::fromUtf8((const char *)xcb_get_property_value(wm_name), xcb_get_property_value_length(wm_name));
@@ -283,8 +284,8 @@ void DForeignPlatformWindow::updateTitle()
 void DForeignPlatformWindow::updateWmClass()
 {
     xcb_get_property_reply_t *wm_class =
-        xcb_get_property_reply(xcb_connection(),
-            xcb_get_property(xcb_connection(), 0, m_window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0L, 2048L), NULL);
+        D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection(),
+            xcb_get_property(xcb_connection(), 0, m_window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0L, 2048L), NULL));
     if (wm_class && wm_class->format == 8
             && wm_class->type == XCB_ATOM_STRING) {
         const QByteArray wm_class_name((const char *)xcb_get_property_value(wm_class), xcb_get_property_value_length(wm_class));
@@ -310,7 +311,7 @@ void DForeignPlatformWindow::updateWindowState()
                      XCB_ATOM_ANY, 0, 1024);
 
     xcb_get_property_reply_t *reply =
-        xcb_get_property_reply(xcb_connection(), get_cookie, NULL);
+        D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection(), get_cookie, NULL));
 
     if (reply && reply->format == 32 && reply->type == atom(QXcbAtom::D_QXCBATOM_WRAPPER(WM_STATE))) {
         const quint32 *data = (const quint32 *)xcb_get_property_value(reply);
@@ -371,7 +372,7 @@ void DForeignPlatformWindow::updateProcessId()
     xcb_get_property_cookie_t cookie = xcb_get_property(xcb_connection(), false, m_window,
                                                         atom(QXcbAtom::D_QXCBATOM_WRAPPER(_NET_WM_PID)), XCB_ATOM_CARDINAL, 0, 1);
     QScopedPointer<xcb_get_property_reply_t, QScopedPointerPodDeleter> reply(
-        xcb_get_property_reply(xcb_connection(), cookie, NULL));
+        D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection(), cookie, NULL)));
     if (reply && reply->type == XCB_ATOM_CARDINAL && reply->format == 32 && reply->value_len == 1) {
         window()->setProperty(ProcessId, *(quint32 *)xcb_get_property_value(reply.data()));
     }
@@ -5,6 +5,7 @@
 #include "dframewindow.h"
 #include "dplatformwindowhelper.h"
 #include "dplatformintegration.h"
+#include "dxcbroundtrip.h"
 
 #ifdef Q_OS_LINUX
 #include "dwmsupport.h"
@@ -18,6 +19,7 @@
 #include <QPainter>
 #include <QGuiApplication>
 #include <QLibrary>
+#include <QPlatformSurfaceEvent>
 #include <QDebug>
 
 #include <private/qguiapplication_p.h>
@@ -52,6 +54,7 @@ public:
         INIT_FUN(cairo_image_surface_create_for_data);
         INIT_FUN(cairo_create);
         INIT_FUN(cairo_surface_mark_dirty);
+        INIT_FUN(cairo_surface_flush);
         INIT_FUN(cairo_set_source_rgb);
         INIT_FUN(cairo_set_source_surface);
         INIT_FUN(cairo_set_operator);
@@ -59,6 +62,11 @@ public:
         INIT_FUN(cairo_line_to);
         INIT_FUN(cairo_curve_to);
         INIT_FUN(cairo_clip);
+        INIT_FUN(cairo_reset_clip);
+        INIT_FUN(cairo_new_path);
+        INIT_FUN(cairo_copy_path);
+        INIT_FUN(cairo_append_path);
+        INIT_FUN(cairo_path_destroy);
         INIT_FUN(cairo_rectangle);
         INIT_FUN(cairo_fill);
         INIT_FUN(cairo_paint);
@@ -84,6 +92,7 @@ public:
     cairo_surface_t *(*cairo_image_surface_create_for_data)(unsigned char *data, cairo_format_t  format, int width, int height, int stride);
     cairo_t *(*cairo_create)(cairo_surface_t *target);
     void (*cairo_surface_mark_dirty)(cairo_surface_t *surface);
+    void (*cairo_surface_flush)(cairo_surface_t *surface);
     void (*cairo_set_source_rgb)(cairo_t *cr, double red, double green, double blue);
     void (*cairo_set_source_surface)(cairo_t *cr, cairo_surface_t *surface, double x, double y);
     void (*cairo_set_operator)(cairo_t *cr, cairo_operator_t op);
@@ -91,6 +100,11 @@ public:
     void (*cairo_line_to)(cairo_t *cr, double x, double y);
     void (*cairo_curve_to)(cairo_t *cr, double x1, double y1, double x2, double y2, double x3, double y3);
     void (*cairo_clip)(cairo_t *cr);
+    void (*cairo_reset_clip)(cairo_t *cr);
+    void (*cairo_new_path)(cairo_t *cr);
+    cairo_path_t *(*cairo_copy_path)(cairo_t *cr);
+    void (*cairo_append_path)(cairo_t *cr, const cairo_path_t *path);
+    void (*cairo_path_destroy)(cairo_path_t *path);
     void (*cairo_rectangle)(cairo_t *cr, double x, double y, double width, double height);
     void (*cairo_fill)(cairo_t *cr);
     void (*cairo_paint)(cairo_t *cr);
@@ -171,7 +185,8 @@ public:
     QRegion flushArea;
 };
 
-QList<DFrameWindow*> DFrameWindow::frameWindowList;
+QHash<quint32, DFrameWindow*> DFrameWindow::frameWindowByClient;
+QHash<quint32, DFrameWindow*> DFrameWindow::frameWindowByFrame;
 
 DFrameWindow::DFrameWindow(QWindow *content)
     : QPaintDeviceWindow(*new DFrameWindowPrivate(), 0)
@@ -204,8 +219,6 @@ DFrameWindow::DFrameWindow(QWindow *content)
 
     updateContentMarginsHint();
 
-    frameWindowList.append(this);
-
     connect(this, &DFrameWindow::windowStateChanged,
             this, &DFrameWindow::updateMask);
     connect(&m_updateShadowTimer, &QTimer::timeout,
@@ -214,9 +227,15 @@ DFrameWindow::DFrameWindow(QWindow *content)
 
 DFrameWindow::~DFrameWindow()
 {
-    frameWindowList.removeOne(this);
+    setClientWinId(0);
+    updateFrameWinIdIndex(true);
 
 #ifdef Q_OS_LINUX
+    releaseFrameImageContext();
+
+    if (clipCairoPath)
+        __cairo->cairo_path_destroy(clipCairoPath);
+
     if (nativeWindowXSurface)
         __cairo->cairo_surface_destroy(nativeWindowXSurface);
 
@@ -561,6 +580,9 @@ set_cursor:
         Utility::startWindowSystemResize(Utility::getNativeTopLevelWindow(winId()), mouseCorner);
         m_isSystemMoveResizeState = true;
 
+        if (DPlatformWindowHelper *helper = DPlatformWindowHelper::mapped.value(m_contentWindow ? m_contentWindow->handle() : nullptr))
+            helper->beginInteractiveResize();
+
         cancelAdsorbCursor();
     } else {
         adsorbCursor(mouseCorner);
@@ -581,11 +603,15 @@ void DFrameWindow::mouseReleaseEvent(QMouseEvent *event)
         m_isSystemMoveResizeState = false;
     }
 
+    DPlatformWindowHelper::endAllInteractiveResize();
+
     return QPaintDeviceWindow::mouseReleaseEvent(event);
 }
 
 void DFrameWindow::resizeEvent(QResizeEvent *event)
 {
+    D_XCB_ROUNDTRIP_OPERATION("resize");
+
     updateFrameMask();
 
     return QPaintDeviceWindow::resizeEvent(event);
@@ -594,6 +620,10 @@ void DFrameWindow::resizeEvent(QResizeEvent *event)
 bool DFrameWindow::event(QEvent *event)
 {
     switch (event->type()) {
+    case QEvent::PlatformSurface:
+        updateFrameWinIdIndex(static_cast<QPlatformSurfaceEvent*>(event)->surfaceEventType()
+                              == QPlatformSurfaceEvent::SurfaceAboutToBeDestroyed);
+        break;
     case QEvent::Enter:
         m_canAdsorbCursor = canResize();
         break;
@@ -608,6 +638,46 @@ bool DFrameWindow::event(QEvent *event)
     return QPaintDeviceWindow::event(event);
 }
 
+void DFrameWindow::setClientWinId(quint32 winId)
+{
+    if (m_clientWinId == winId)
+        return;
+
+    if (m_clientWinId && frameWindowByClient.value(m_clientWinId) == this)
+        frameWindowByClient.remove(m_clientWinId);
+
+    m_clientWinId = winId;
+
+    if (m_clientWinId)
+        frameWindowByClient[m_clientWinId] = this;
+}
+
+void DFrameWindow::updateFrameWinIdIndex(bool remove)
+{
+    const quint32 win_id = (!remove && handle()) ? quint32(handle()->winId()) : 0;
+
+    if (m_frameWinId == win_id)
+        return;
+
+    if (m_frameWinId && frameWindowByFrame.value(m_frameWinId) == this)
+        frameWindowByFrame.remove(m_frameWinId);
+
+    m_frameWinId = win_id;
+
+    if (m_frameWinId)
+        frameWindowByFrame[m_frameWinId] = this;
+}
+
+DFrameWindow *DFrameWindow::findByClientWinId(quint32 winId)
+{
+    return frameWindowByClient.value(winId);
+}
+
+DFrameWindow *DFrameWindow::findByFrameWinId(quint32 winId)
+{
+    return frameWindowByFrame.value(winId);
+}
+
 void DFrameWindow::timerEvent(QTimerEvent *event)
 {
     Q_D(DFrameWindow);
@@ -620,6 +690,13 @@ void DFrameWindow::timerEvent(QTimerEvent *event)
             platformBackingStore->flush(this, d->flushArea, QPoint(0, 0));
             d->flushArea = QRegion();
         }
+#ifdef Q_OS_LINUX
+    } else if (event->timerId() == m_damageTimerId) {
+        killTimer(m_damageTimerId);
+        m_damageTimerId = -1;
+
+        flushDamagedArea();
+#endif
     } else if (event->timerId() == m_paintShadowOnContentTimerId) {
         killTimer(m_paintShadowOnContentTimerId);
         m_paintShadowOnContentTimerId = -1;
@@ -678,30 +755,56 @@ void DFrameWindow::updateFromContents(void *ev)
         return;
     }
 
-    xcb_connection_t *connect = DPlatformIntegration::xcbConnection()->xcb_connection();
     xcb_damage_notify_event_t *event = reinterpret_cast<xcb_damage_notify_event_t*>(ev);
-    xcb_xfixes_region_t parts = xcb_generate_id(connect);
 
-    xcb_xfixes_create_region(connect, parts, 0, 0);
-    xcb_damage_subtract(connect, event->damage, XCB_NONE, parts);
+    // damage的报告级别为BoundingBox，事件中已带有受损区域的外接矩形，无需再向服务器查询。
+    // 同一次事件循环中收到的所有事件合并后统一处理
+    m_damage = event->damage;
+    m_damagedArea += QRect(event->area.x, event->area.y, event->area.width, event->area.height);
 
-    xcb_xfixes_fetch_region_cookie_t cookie = xcb_xfixes_fetch_region(connect, parts);
-    xcb_xfixes_fetch_region_reply_t *reply = xcb_xfixes_fetch_region_reply(connect, cookie, 0);
+    if (m_damageTimerId < 0)
+        m_damageTimerId = startTimer(0);
+#else
+    Q_UNUSED(ev)
+#endif
+}
 
-    if (Q_UNLIKELY(!reply))
+#ifdef Q_OS_LINUX
+void DFrameWindow::flushDamagedArea()
+{
+    if (m_damagedArea.isEmpty())
         return;
 
-    xcb_rectangle_t *rectangles = xcb_xfixes_fetch_region_rectangles(reply);
-    int length = xcb_xfixes_fetch_region_rectangles_length(reply);
+    xcb_connection_t *connect = DPlatformIntegration::xcbConnection()->xcb_connection();
 
-    if (!xsurfaceDirtySize.isEmpty())
-        updateNativeWindowXPixmap(xsurfaceDirtySize.width(), xsurfaceDirtySize.height());
+    // 先清空服务器中的damage，在此之后的绘制会产生新的事件
+    xcb_damage_subtract(connect, m_damage, XCB_NONE, XCB_NONE);
 
-    drawNativeWindowXPixmap(rectangles, length);
+    if (!xsurfaceDirtySize.isEmpty()
+            && updateNativeWindowXPixmap(xsurfaceDirtySize.width(), xsurfaceDirtySize.height())) {
+        xsurfaceDirtySize = QSize();
+    }
 
-    free(reply);
-#endif
+    QVector<xcb_rectangle_t> rectangles;
+
+    rectangles.reserve(m_damagedArea.rectCount());
+
+    for (const QRect &rect : m_damagedArea) {
+        xcb_rectangle_t r;
+
+        r.x = rect.x();
+        r.y = rect.y();
+        r.width = rect.width();
+        r.height = rect.height();
+
+        rectangles << r;
+    }
+
+    m_damagedArea = QRegion();
+
+    drawNativeWindowXPixmap(rectangles.data(), rectangles.size());
 }
+#endif
 
 void DFrameWindow::drawShadowTo(QPaintDevice *device)
 {
@@ -756,6 +859,9 @@ void DFrameWindow::setContentPath(const QPainterPath &path, bool isRoundedRect,
 
     m_clipPathOfContent = path;
     m_clipPath = path.translated(contentOffsetHint()) * device_pixel_ratio;
+#ifdef Q_OS_LINUX
+    clipCairoPathDirty = true;
+#endif
 
     if (isRoundedRect && m_pathIsRoundedRect == isRoundedRect && m_roundedRectRadius == radius && !m_shadowImage.isNull()) {
         const QMargins margins(qMax(m_shadowRadius + radius + qAbs(m_shadowOffset.x()), m_borderWidth),
@@ -797,14 +903,104 @@ void DFrameWindow::drawNativeWindowXPixmap(xcb_rectangle_t *rects, int length)
     QImage image(const_cast<uchar*>(source_image.bits()),
                  source_image.width(), source_image.height(),
                  source_image.bytesPerLine(), source_image.format());
-    const cairo_format_t format = cairo_format_from_qimage_format(image.format());
-    cairo_surface_t *surface = __cairo->cairo_image_surface_create_for_data(image.bits(), format, image.width(), image.height(), image.bytesPerLine());
-    cairo_t *cr = __cairo->cairo_create(surface);
+    cairo_t *cr = ensureFrameImageContext(image, offset);
+
+    if (Q_UNLIKELY(!cr))
+        return;
 
     __cairo->cairo_surface_mark_dirty(nativeWindowXSurface);
-    __cairo->cairo_set_source_rgb(cr, 0, 255, 0);
-    __cairo->cairo_set_source_surface(cr, nativeWindowXSurface, offset.x(), offset.y());
-    __cairo->cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    // 两次绘制之间Qt可能直接修改过此图片的内容
+    __cairo->cairo_surface_mark_dirty(frameImageSurface);
+
+    if (rects) {
+        for (int i = 0; i < length; ++i) {
+            const xcb_rectangle_t &rect = rects[i];
+
+            d_func()->flushArea += QRect(rect.x + offset.x(), rect.y + offset.y(), rect.width, rect.height);
+            __cairo->cairo_rectangle(cr, rect.x + offset.x(), rect.y + offset.y(), rect.width, rect.height);
+            __cairo->cairo_fill(cr);
+        }
+
+        __cairo->cairo_surface_flush(frameImageSurface);
+    } else {
+        __cairo->cairo_paint(cr);
+        __cairo->cairo_surface_flush(frameImageSurface);
+
+        // draw shadow
+        drawShadowTo(&image);
+        d_func()->flushArea = QRect(QPoint(0, 0), d_func()->size);
+    }
+
+    d_func()->flush(QRegion());
+}
+
+cairo_t *DFrameWindow::ensureFrameImageContext(const QImage &image, const QPoint &offset)
+{
+    // 只有图片的内存发生变化（如窗口大小改变）时才重新创建surface和context
+    if (frameImageCairo && (image.constBits() != frameImageBits || image.size() != frameImageSize
+                               || image.bytesPerLine() != frameImageBytesPerLine || image.format() != frameImageFormat)) {
+        releaseFrameImageContext();
+    }
+
+    if (!frameImageCairo) {
+        const cairo_format_t format = cairo_format_from_qimage_format(image.format());
+        frameImageSurface = __cairo->cairo_image_surface_create_for_data(const_cast<uchar*>(image.constBits()), format,
+                                                                         image.width(), image.height(), image.bytesPerLine());
+        frameImageCairo = __cairo->cairo_create(frameImageSurface);
+        frameImageBits = image.constBits();
+        frameImageSize = image.size();
+        frameImageBytesPerLine = image.bytesPerLine();
+        frameImageFormat = image.format();
+
+        __cairo->cairo_set_operator(frameImageCairo, CAIRO_OPERATOR_SOURCE);
+        __cairo->cairo_set_source_surface(frameImageCairo, nativeWindowXSurface, offset.x(), offset.y());
+        frameImageSourceOffset = offset;
+
+        // 新的context中没有裁剪区域，直接使用缓存的路径
+        if (clipCairoPath && !clipCairoPathDirty) {
+            __cairo->cairo_new_path(frameImageCairo);
+            __cairo->cairo_append_path(frameImageCairo, clipCairoPath);
+            __cairo->cairo_clip(frameImageCairo);
+        }
+    } else if (offset != frameImageSourceOffset) {
+        __cairo->cairo_set_source_surface(frameImageCairo, nativeWindowXSurface, offset.x(), offset.y());
+        frameImageSourceOffset = offset;
+    }
+
+    if (clipCairoPathDirty)
+        updateClipCairoPath();
+
+    return frameImageCairo;
+}
+
+void DFrameWindow::releaseFrameImageContext()
+{
+    if (frameImageCairo) {
+        __cairo->cairo_destroy(frameImageCairo);
+        frameImageCairo = nullptr;
+    }
+
+    if (frameImageSurface) {
+        __cairo->cairo_surface_destroy(frameImageSurface);
+        frameImageSurface = nullptr;
+    }
+
+    frameImageBits = nullptr;
+}
+
+void DFrameWindow::updateClipCairoPath()
+{
+    cairo_t *cr = frameImageCairo;
+
+    clipCairoPathDirty = false;
+
+    if (clipCairoPath) {
+        __cairo->cairo_path_destroy(clipCairoPath);
+        clipCairoPath = nullptr;
+    }
+
+    __cairo->cairo_reset_clip(cr);
+    __cairo->cairo_new_path(cr);
 
     bool clip = false;
 
@@ -835,29 +1031,9 @@ void DFrameWindow::drawNativeWindowXPixmap(xcb_rectangle_t *rects, int length)
     }
 
     if (clip) {
+        clipCairoPath = __cairo->cairo_copy_path(cr);
         __cairo->cairo_clip(cr);
     }
-
-    if (rects) {
-        for (int i = 0; i < length; ++i) {
-            const xcb_rectangle_t &rect = rects[i];
-
-            d_func()->flushArea += QRect(rect.x + offset.x(), rect.y + offset.y(), rect.width, rect.height);
-            __cairo->cairo_rectangle(cr, rect.x + offset.x(), rect.y + offset.y(), rect.width, rect.height);
-            __cairo->cairo_fill(cr);
-        }
-    } else {
-        __cairo->cairo_paint(cr);
-
-        // draw shadow
-        drawShadowTo(&image);
-        d_func()->flushArea = QRect(QPoint(0, 0), d_func()->size);
-    }
-
-    __cairo->cairo_destroy(cr);
-    __cairo->cairo_surface_destroy(surface);
-
-    d_func()->flush(QRegion());
 }
 
 bool DFrameWindow::updateNativeWindowXPixmap(int width, int height)
@@ -880,13 +1056,16 @@ bool DFrameWindow::updateNativeWindowXPixmap(int width, int height)
     }
 
     xcb_void_cookie_t cookie = xcb_composite_name_window_pixmap_checked(connect, winId, nativeWindowXPixmap);
-    QScopedPointer<xcb_generic_error_t, QScopedPointerPodDeleter> error(xcb_request_check(connect, cookie));
+    QScopedPointer<xcb_generic_error_t, QScopedPointerPodDeleter> error(D_XCB_ROUNDTRIP(xcb_request_check(connect, cookie)));
 
     if (error) {
         nativeWindowXPixmap = XCB_PIXMAP_NONE;
         return false;
     }
 
+    // 窗口的pixmap已改变，不再复用之前的context
+    releaseFrameImageContext();
+
     if (Q_LIKELY(nativeWindowXSurface)) {
         __cairo->cairo_xlib_surface_set_drawable(nativeWindowXSurface, nativeWindowXPixmap, width, height);
     } else if (__cairo->isValid()) {
@@ -926,19 +1105,30 @@ void DFrameWindow::updateShadow()
         return;
 
     qreal device_pixel_ratio = devicePixelRatio();
-    QPixmap pixmap(m_contentGeometry.size() * device_pixel_ratio);
 
-    if (pixmap.isNull())
-        return;
+    if (m_pathIsRoundedRect) {
+        // 圆角矩形的阴影可由缓存的图块拼接，无需每次都对整个窗口大小的图片做模糊
+        m_shadowImage = Utility::roundedRectShadow(m_contentGeometry.size() * device_pixel_ratio, m_roundedRectRadius * device_pixel_ratio,
+                                                   m_shadowRadius * device_pixel_ratio, m_shadowColor);
+    } else {
+        QPixmap pixmap(m_contentGeometry.size() * device_pixel_ratio);
 
-    pixmap.fill(Qt::transparent);
+        if (pixmap.isNull())
+            return;
 
-    QPainter pa(&pixmap);
+        pixmap.fill(Qt::transparent);
 
-    pa.fillPath(m_clipPath.translated(-m_contentGeometry.topLeft() * device_pixel_ratio), m_shadowColor);
-    pa.end();
+        QPainter pa(&pixmap);
+
+        pa.fillPath(m_clipPath.translated(-m_contentGeometry.topLeft() * device_pixel_ratio), m_shadowColor);
+        pa.end();
+
+        m_shadowImage = Utility::dropShadow(pixmap, m_shadowRadius * device_pixel_ratio, m_shadowColor);
+    }
+
+    if (m_shadowImage.isNull())
+        return;
 
-    m_shadowImage = Utility::dropShadow(pixmap, m_shadowRadius * device_pixel_ratio, m_shadowColor);
     update();
 
     // 阴影更新后尝试刷新内部窗口
@@ -982,6 +1172,9 @@ void DFrameWindow::updateContentMarginsHint(bool force)
                                 m_contentMarginsHint.top() - old_margins.top());
 
     m_clipPath = m_clipPathOfContent.translated(contentOffsetHint()) * device_pixel_ratio;
+#ifdef Q_OS_LINUX
+    clipCairoPathDirty = true;
+#endif
 
     qreal width_extra = (m_contentMarginsHint.left() + m_contentMarginsHint.right()) * device_pixel_ratio;
     qreal height_extra = (m_contentMarginsHint.top() + m_contentMarginsHint.bottom()) * device_pixel_ratio;
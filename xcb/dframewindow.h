@@ -12,6 +12,7 @@
 #include <QVariantAnimation>
 #include <QTimer>
 #include <QPointer>
+#include <QHash>
 
 #ifdef Q_OS_LINUX
 #include <cairo.h>
@@ -91,6 +92,10 @@ private:
 #ifdef Q_OS_LINUX
     void drawNativeWindowXPixmap(xcb_rectangle_t *rects = 0, int length = 0);
     bool updateNativeWindowXPixmap(int width, int height);
+    cairo_t *ensureFrameImageContext(const QImage &image, const QPoint &offset);
+    void releaseFrameImageContext();
+    void updateClipCairoPath();
+    void flushDamagedArea();
     void markXPixmapToDirty(int width = -1, int height = -1);
 #endif
 
@@ -109,7 +114,17 @@ private:
 
     void onDevicePixelRatioChanged();
 
-    static QList<DFrameWindow*> frameWindowList;
+    void setClientWinId(quint32 winId);
+    void updateFrameWinIdIndex(bool remove = false);
+
+    static DFrameWindow *findByClientWinId(quint32 winId);
+    static DFrameWindow *findByFrameWinId(quint32 winId);
+
+    // 以内容窗口(client)和frame窗口自身的窗口id为键索引所有的frame窗口
+    static QHash<quint32, DFrameWindow*> frameWindowByClient;
+    static QHash<quint32, DFrameWindow*> frameWindowByFrame;
+    quint32 m_clientWinId = 0;
+    quint32 m_frameWinId = 0;
 
     QPlatformBackingStore *platformBackingStore;
 
@@ -152,7 +167,21 @@ private:
 #ifdef Q_OS_LINUX
     uint32_t nativeWindowXPixmap = 0;
     cairo_surface_t *nativeWindowXSurface = 0;
+    // 绘制重定向窗口内容时复用的surface、context及裁剪路径
+    cairo_surface_t *frameImageSurface = nullptr;
+    cairo_t *frameImageCairo = nullptr;
+    const uchar *frameImageBits = nullptr;
+    QSize frameImageSize;
+    int frameImageBytesPerLine = 0;
+    QImage::Format frameImageFormat = QImage::Format_Invalid;
+    QPoint frameImageSourceOffset;
+    cairo_path_t *clipCairoPath = nullptr;
+    bool clipCairoPathDirty = true;
     QSize xsurfaceDirtySize;
+    // 尚未绘制的受损区域
+    uint32_t m_damage = 0;
+    QRegion m_damagedArea;
+    int m_damageTimerId = -1;
 #endif
 
     friend class DPlatformWindowHelper;
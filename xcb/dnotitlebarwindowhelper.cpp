@@ -90,6 +90,7 @@ DNoTitlebarWindowHelper::~DNoTitlebarWindowHelper()
     }
 
     mapped.remove(static_cast<QWindow*>(parent()));
+    Utility::removeWindowBlurCache(m_windowID);
 
     if (m_window->handle()) { // 当本地窗口还存在时，移除设置过的窗口属性
         Utility::clearWindowProperty(m_windowID, Utility::internAtom(_DEEPIN_SCISSOR_WINDOW));
@@ -7,6 +7,7 @@
 #include "dplatformwindowhelper.h"
 #include "dframewindow.h"
 #include "dwmsupport.h"
+#include "dxcbroundtrip.h"
 
 #ifdef Q_OS_LINUX
 #define private public
@@ -81,6 +82,8 @@ void DPlatformBackingStoreHelper::beginPaint(const QRegion &region)
 
 void DPlatformBackingStoreHelper::flush(QWindow *window, const QRegion &region, const QPoint &offset)
 {
+    D_XCB_ROUNDTRIP_OPERATION("flush");
+
     if (!backingStore()->paintDevice())
         return;
 
@@ -161,29 +164,34 @@ void DPlatformBackingStoreHelper::resize(const QSize &size, const QRegion &stati
 
     QXcbBackingStore *bs = static_cast<QXcbBackingStore*>(backingStore());
     QXcbShmImage *shm_image = reinterpret_cast<QXcbShmImage*>(bs->m_image);
+    DPlatformWindowHelper *window_helper = DPlatformWindowHelper::mapped.value(bs->window()->handle());
+
+    if (!window_helper)
+        return;
 
-    if (shm_image->m_shm_info.shmaddr) {
-        DPlatformWindowHelper *window_helper = DPlatformWindowHelper::mapped.value(bs->window()->handle());
+    xcb_atom_t atom = Utility::internAtom("_DEEPIN_DXCB_SHM_INFO", false);
 
-        if (!window_helper)
-            return;
-
-        xcb_atom_t atom = Utility::internAtom("_DEEPIN_DXCB_SHM_INFO", false);
-        QVector<quint32> info;
-        const QImage &qimage = bs->toImage();
-
-        info << shm_image->m_shm_info.shmid // 共享内存 id
-             << qimage.width() // 图片宽度
-             << qimage.height() // 图片高度
-             << qimage.bytesPerLine() // 同QImage::bytesPerLine
-             << qimage.format() // 图片格式
-             << 0 // 图片有效区域的x
-             << 0 // 图片有效区域的y
-             << qimage.width() // 图片有效区域的宽度
-             << qimage.height(); // 图片有效区域的高度
-
-        Utility::setWindowProperty(window_helper->m_frameWindow->winId(), atom, XCB_ATOM_CARDINAL, info.constData(), info.length(), sizeof(quint32) * 8);
+    // Qt 未能为新尺寸分配共享内存(如超出限制或 MIT-SHM 不可用)时退回普通内存，
+    // 此时要移除之前发布的信息，避免使用者继续读取已被释放的共享内存段
+    if (!shm_image || !shm_image->m_shm_info.shmaddr) {
+        Utility::clearWindowProperty(window_helper->m_frameWindow->winId(), atom);
+        return;
     }
+
+    QVector<quint32> info;
+    const QImage &qimage = bs->toImage();
+
+    info << shm_image->m_shm_info.shmid // 共享内存 id
+         << qimage.width() // 图片宽度
+         << qimage.height() // 图片高度
+         << qimage.bytesPerLine() // 同QImage::bytesPerLine
+         << qimage.format() // 图片格式
+         << 0 // 图片有效区域的x
+         << 0 // 图片有效区域的y
+         << qimage.width() // 图片有效区域的宽度
+         << qimage.height(); // 图片有效区域的高度
+
+    Utility::setWindowProperty(window_helper->m_frameWindow->winId(), atom, XCB_ATOM_CARDINAL, info.constData(), info.length(), sizeof(quint32) * 8);
 }
 #endif
 
@@ -11,6 +11,7 @@
 #include "dforeignplatformwindow.h"
 #include "vtablehook.h"
 #include "dwmsupport.h"
+#include "dxcbroundtrip.h"
 #include "dnotitlebarwindowhelper.h"
 #include "dnativesettings.h"
 #include "dbackingstoreproxy.h"
@@ -312,6 +313,8 @@ static void nativeWindowDestroyed(QNativeWindow *w)
 
 QPlatformWindow *DPlatformIntegration::createPlatformWindow(QWindow *window) const
 {
+    D_XCB_ROUNDTRIP_OPERATION("window creation");
+
     qCDebug(lcDxcb) << "window:" << window << "window type:" << window->type() << "parent:" << window->parent();
 
     if (qEnvironmentVariableIsSet("DXCB_PRINT_WINDOW_CREATE")) {
@@ -724,9 +727,9 @@ static xcb_cursor_t qt_xcb_createCursorXRender(QXcbScreen *screen, const QImage
     const int h = image.height();
     xcb_generic_error_t *error = 0;
     xcb_render_query_pict_formats_cookie_t formatsCookie = xcb_render_query_pict_formats(conn);
-    xcb_render_query_pict_formats_reply_t *formatsReply = xcb_render_query_pict_formats_reply(conn,
+    xcb_render_query_pict_formats_reply_t *formatsReply = D_XCB_ROUNDTRIP(xcb_render_query_pict_formats_reply(conn,
                                                                                               formatsCookie,
-                                                                                              &error);
+                                                                                              &error));
     if (!formatsReply || error) {
         qWarning("qt_xcb_createCursorXRender: query_pict_formats failed");
         free(formatsReply);
@@ -1096,6 +1099,9 @@ void DPlatformIntegration::initialize()
     }
 
 #ifdef Q_OS_LINUX
+    // 后续的事件处理中会频繁用到这些atom，提前一次性申请，避免每次都产生同步的往返请求
+    Utility::prefetchAtoms(xcbConnection()->xcb_connection());
+
 #if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
     m_eventFilter = new XcbNativeEventFilter(connection());
 #else
@@ -9,6 +9,7 @@
 #include "dplatformintegration.h"
 
 #include "dwmsupport.h"
+#include "dxcbroundtrip.h"
 
 #ifdef Q_OS_LINUX
 #include "xcbnativeeventfilter.h"
@@ -79,7 +80,10 @@ static QFunctionPointer getFunction(const QByteArray &function)
         {supportForSplittingWindow, reinterpret_cast<QFunctionPointer>(&Utility::supportForSplittingWindow)},
         {sendEndStartupNotifition, reinterpret_cast<QFunctionPointer>(&DPlatformIntegration::sendEndStartupNotifition)},
         {splitWindowOnScreenByType, reinterpret_cast<QFunctionPointer>(&Utility::splitWindowOnScreenByType)},
-        {supportForSplittingWindowByType, reinterpret_cast<QFunctionPointer>(&Utility::supportForSplittingWindowByType)}
+        {supportForSplittingWindowByType, reinterpret_cast<QFunctionPointer>(&Utility::supportForSplittingWindowByType)},
+#ifdef DXCB_ROUNDTRIP_STATS
+        {xcbRoundTripStatistics, reinterpret_cast<QFunctionPointer>(&DXcbRoundTrip::report)},
+#endif
     };
 
     return functionCache.value(function);
@@ -7,6 +7,7 @@
 #include "dframewindow.h"
 #include "vtablehook.h"
 #include "dwmsupport.h"
+#include "dxcbroundtrip.h"
 
 #ifdef Q_OS_LINUX
 #include "xcbnativeeventfilter.h"
@@ -26,6 +27,7 @@
 #include <qpa/qplatformcursor.h>
 
 #include <QPainterPath>
+#include <QTimerEvent>
 
 Q_DECLARE_METATYPE(QPainterPath)
 Q_DECLARE_METATYPE(QMargins)
@@ -52,6 +54,7 @@ DPlatformWindowHelper::DPlatformWindowHelper(QNativeWindow *window)
     m_frameWindow = new DFrameWindow(window->window());
     m_frameWindow->setFlags((window->window()->flags() | Qt::FramelessWindowHint | Qt::CustomizeWindowHint | Qt::NoDropShadowWindowHint) & ~Qt::WindowMinMaxButtonsHint);
     m_frameWindow->create();
+    m_frameWindow->setClientWinId(window->QNativeWindow::winId());
     m_frameWindow->installEventFilter(this);
     m_frameWindow->setShadowRadius(getShadowRadius());
     m_frameWindow->setShadowColor(m_shadowColor);
@@ -73,7 +76,8 @@ DPlatformWindowHelper::DPlatformWindowHelper(QNativeWindow *window)
     if (windowRedirectContent(window->window())) {
         xcb_composite_redirect_window(window->xcb_connection(), window->xcb_window(), XCB_COMPOSITE_REDIRECT_MANUAL);
         damage_id = xcb_generate_id(window->xcb_connection());
-        xcb_damage_create(window->xcb_connection(), damage_id, window->xcb_window(), XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+        // 每次受损区域的外接矩形变大时都会收到事件，不需要再通过xfixes获取具体的区域
+        xcb_damage_create(window->xcb_connection(), damage_id, window->xcb_window(), XCB_DAMAGE_REPORT_LEVEL_BOUNDING_BOX);
     }
 #endif
 
@@ -143,6 +147,18 @@ DPlatformWindowHelper::DPlatformWindowHelper(QNativeWindow *window)
 DPlatformWindowHelper::~DPlatformWindowHelper()
 {
     mapped.remove(m_nativeWindow);
+    m_interactiveResizeTimer.stop();
+    // 模糊区域设置在frame窗口所在的顶层窗口(可能是窗管创建的窗口)上，窗口id可能被X server重新分配给其它窗口
+    if (m_frameWindow->handle()) {
+        const quint32 frame_w = m_frameWindow->winId();
+        const quint32 top_level_w = Utility::getNativeTopLevelWindow(frame_w);
+
+        Utility::removeWindowBlurCache(frame_w);
+
+        if (top_level_w != frame_w)
+            Utility::removeWindowBlurCache(top_level_w);
+    }
+    m_frameWindow->setClientWinId(0);
     m_frameWindow->deleteLater();
 
 #ifdef Q_OS_LINUX
@@ -158,6 +174,8 @@ DPlatformWindowHelper *DPlatformWindowHelper::me() const
 
 void DPlatformWindowHelper::setGeometry(const QRect &rect)
 {
+    D_XCB_ROUNDTRIP_OPERATION("resize");
+
     DPlatformWindowHelper *helper = me();
 
     qreal device_pixel_ratio = helper->m_frameWindow->devicePixelRatio();
@@ -510,12 +528,26 @@ bool DPlatformWindowHelper::setWindowModified(bool modified)
 #if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
 bool DPlatformWindowHelper::startSystemResize(const QPoint &pos, Qt::Corner corner)
 {
-    return me()->m_frameWindow->handle()->startSystemResize(pos, corner);
+    DPlatformWindowHelper *helper = me();
+
+    if (!helper->m_frameWindow->handle()->startSystemResize(pos, corner))
+        return false;
+
+    helper->beginInteractiveResize();
+
+    return true;
 }
 #else
 bool DPlatformWindowHelper::startSystemResize(Qt::Edges edges)
 {
-    return me()->m_frameWindow->handle()->startSystemResize(edges);
+    DPlatformWindowHelper *helper = me();
+
+    if (!helper->m_frameWindow->handle()->startSystemResize(edges))
+        return false;
+
+    helper->beginInteractiveResize();
+
+    return true;
 }
 #endif
 
@@ -776,6 +808,8 @@ bool DPlatformWindowHelper::eventFilter(QObject *watched, QEvent *event)
                 m_frameWindow->m_isSystemMoveResizeState = false;
             }
 
+            endInteractiveResize();
+
             break;
         }
         case QEvent::PlatformSurface: {
@@ -832,6 +866,17 @@ bool DPlatformWindowHelper::eventFilter(QObject *watched, QEvent *event)
     return false;
 }
 
+void DPlatformWindowHelper::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != m_interactiveResizeTimer.timerId())
+        return QObject::timerEvent(event);
+
+    m_interactiveResizeTimer.stop();
+
+    if (m_clipPathDecorationsDirty)
+        updateClipPathDecorations();
+}
+
 void DPlatformWindowHelper::setNativeWindowGeometry(const QRect &rect, bool onlyResize)
 {
     qt_window_private(m_nativeWindow->window())->parentWindow = m_frameWindow;
@@ -874,11 +919,56 @@ void DPlatformWindowHelper::setClipPath(const QPainterPath &path)
         setWindowValidGeometry(m_clipPath.boundingRect().toRect() & QRect(QPoint(0, 0), m_nativeWindow->window()->size()));
     }
 
+    if (m_interactiveResizing) {
+        markClipPathDecorationsDirty();
+        return;
+    }
+
+    updateClipPathDecorations();
+}
+
+void DPlatformWindowHelper::updateClipPathDecorations()
+{
+    m_clipPathDecorationsDirty = false;
+
     updateWindowShape();
     updateWindowBlurAreasForWM();
     updateContentPathForFrameWindow();
 }
 
+void DPlatformWindowHelper::markClipPathDecorationsDirty()
+{
+    m_clipPathDecorationsDirty = true;
+
+    // 每帧最多更新一次，不重启已在运行的定时器，避免持续缩放时一直得不到更新
+    if (!m_interactiveResizeTimer.isActive())
+        m_interactiveResizeTimer.start(16, this);
+}
+
+void DPlatformWindowHelper::beginInteractiveResize()
+{
+    m_interactiveResizing = true;
+}
+
+void DPlatformWindowHelper::endInteractiveResize()
+{
+    if (!m_interactiveResizing)
+        return;
+
+    m_interactiveResizing = false;
+    m_interactiveResizeTimer.stop();
+
+    if (m_clipPathDecorationsDirty)
+        updateClipPathDecorations();
+}
+
+void DPlatformWindowHelper::endAllInteractiveResize()
+{
+    for (DPlatformWindowHelper *helper : mapped) {
+        helper->endInteractiveResize();
+    }
+}
+
 void DPlatformWindowHelper::setWindowValidGeometry(const QRect &geometry, bool force)
 {
     if (!force && geometry == m_windowValidGeometry)
@@ -886,6 +976,11 @@ void DPlatformWindowHelper::setWindowValidGeometry(const QRect &geometry, bool f
 
     m_windowValidGeometry = geometry;
 
+    if (m_interactiveResizing) {
+        markClipPathDecorationsDirty();
+        return;
+    }
+
     // The native window geometry may not update now, we need to wait for resize
     // event to proceed.
     QTimer::singleShot(0, this, &DPlatformWindowHelper::updateWindowBlurAreasForWM);
@@ -1076,7 +1171,7 @@ void DPlatformWindowHelper::updateWindowNormalHints()
 
     xcb_get_property_cookie_t cookie = xcb_icccm_get_wm_normal_hints(m_nativeWindow->xcb_connection(), m_frameWindow->winId());
 
-    if (xcb_get_property_reply_t *reply = xcb_get_property_reply(m_nativeWindow->xcb_connection(), cookie, 0)) {
+    if (xcb_get_property_reply_t *reply = D_XCB_ROUNDTRIP(xcb_get_property_reply(m_nativeWindow->xcb_connection(), cookie, 0))) {
         xcb_icccm_get_wm_size_hints_from_reply(&hints, reply);
         free(reply);
 
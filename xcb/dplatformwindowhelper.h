@@ -24,6 +24,8 @@ typedef QWindowsWindow QNativeWindow;
 #include "global.h"
 #include "utility.h"
 
+#include <QBasicTimer>
+
 DPP_BEGIN_NAMESPACE
 
 class DFrameWindow;
@@ -96,12 +98,20 @@ public:
 
     static bool windowRedirectContent(QWindow *window);
 
+    // 交互式调整窗口大小期间，裁剪路径引起的窗口形状、模糊区域及阴影的更新合并到定时器中
+    void beginInteractiveResize();
+    void endInteractiveResize();
+    static void endAllInteractiveResize();
+
 private:
     bool eventFilter(QObject *watched, QEvent *event) Q_DECL_OVERRIDE;
+    void timerEvent(QTimerEvent *event) Q_DECL_OVERRIDE;
     void setNativeWindowGeometry(const QRect &rect, bool onlyResize = false);
 
     void updateClipPathByWindowRadius(const QSize &windowSize);
     void setClipPath(const QPainterPath &path);
+    void updateClipPathDecorations();
+    void markClipPathDecorationsDirty();
     void setWindowValidGeometry(const QRect &geometry, bool force = false);
     bool updateWindowBlurAreasForWM();
     void updateSizeHints();
@@ -178,9 +188,14 @@ private:
     uint32_t damage_id = 0;
 #endif
 
+    bool m_interactiveResizing = false;
+    bool m_clipPathDecorationsDirty = false;
+    QBasicTimer m_interactiveResizeTimer;
+
     friend class DPlatformBackingStoreHelper;
     friend class DPlatformOpenGLContextHelper;
     friend class DPlatformIntegration;
+    friend class DFrameWindow;
     friend class DPlatformNativeInterfaceHook;
     friend class XcbNativeEventFilter;
     friend class WindowEventHook;
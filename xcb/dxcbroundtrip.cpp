@@ -0,0 +1,172 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "dxcbroundtrip.h"
+
+#ifdef DXCB_ROUNDTRIP_STATS
+#include <QCoreApplication>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QStringList>
+#include <QTextStream>
+
+#include <algorithm>
+
+DPP_BEGIN_NAMESPACE
+
+Q_LOGGING_CATEGORY(lcRoundTrip, "dtk.qpa.dxcb.roundtrip")
+
+namespace {
+struct Statistic
+{
+    quint64 count = 0;
+    qint64 totalNsecs = 0;
+    qint64 maxNsecs = 0;
+
+    void add(qint64 nsecs)
+    {
+        ++count;
+        totalNsecs += nsecs;
+        maxNsecs = qMax(maxNsecs, nsecs);
+    }
+};
+
+// key 为(操作名, 调用位置)，两者都是字符串常量，直接比较指针即可
+typedef QPair<const char*, const char*> StatisticKey;
+
+struct Statistics
+{
+    QMutex mutex;
+    QHash<StatisticKey, Statistic> data;
+};
+}
+
+Q_GLOBAL_STATIC(Statistics, statistics)
+
+static thread_local const char *currentOperation = nullptr;
+static const char unknownOperation[] = "other";
+
+DXcbRoundTrip::Operation::Operation(const char *name)
+    : m_previous(currentOperation)
+{
+    currentOperation = name;
+}
+
+DXcbRoundTrip::Operation::~Operation()
+{
+    currentOperation = m_previous;
+}
+
+void DXcbRoundTrip::record(const char *site, qint64 nsecs)
+{
+    Statistics *s = statistics;
+
+    if (!s)
+        return;
+
+    QMutexLocker locker(&s->mutex);
+
+    // 程序退出时输出统计结果
+    if (s->data.isEmpty() && QCoreApplication::instance()) {
+        static bool registered = false;
+
+        if (!registered) {
+            registered = true;
+            qAddPostRoutine(&DXcbRoundTrip::dump);
+        }
+    }
+
+    s->data[StatisticKey(currentOperation ? currentOperation : unknownOperation, site)].add(nsecs);
+}
+
+static const char *fileName(const char *path)
+{
+    const char *name = strrchr(path, '/');
+
+    return name ? name + 1 : path;
+}
+
+/*!
+ * \brief 返回按操作分组、按等待总时长排序的统计结果
+ * \param reset 为true时清空已有的统计数据
+ * \return
+ */
+QString DXcbRoundTrip::report(bool reset)
+{
+    QHash<StatisticKey, Statistic> data;
+
+    if (Statistics *s = statistics) {
+        QMutexLocker locker(&s->mutex);
+        data = s->data;
+
+        if (reset)
+            s->data.clear();
+    }
+
+    QHash<QByteArray, Statistic> operations;
+    QList<StatisticKey> keys = data.keys();
+
+    for (const StatisticKey &key : keys) {
+        Statistic &operation = operations[QByteArray(key.first)];
+        const Statistic &site = data.value(key);
+        operation.count += site.count;
+        operation.totalNsecs += site.totalNsecs;
+        operation.maxNsecs = qMax(operation.maxNsecs, site.maxNsecs);
+    }
+
+    std::sort(keys.begin(), keys.end(), [&](const StatisticKey &a, const StatisticKey &b) {
+        const qint64 a_total = operations.value(QByteArray(a.first)).totalNsecs;
+        const qint64 b_total = operations.value(QByteArray(b.first)).totalNsecs;
+
+        if (a_total != b_total)
+            return a_total > b_total;
+
+        if (qstrcmp(a.first, b.first) != 0)
+            return qstrcmp(a.first, b.first) < 0;
+
+        return data.value(a).totalNsecs > data.value(b).totalNsecs;
+    });
+
+    QString text;
+    QTextStream stream(&text);
+    const char *last_operation = nullptr;
+
+    stream << "X round trips: operation/call site, count, total(us), max(us)\n";
+
+    for (const StatisticKey &key : keys) {
+        if (!last_operation || qstrcmp(last_operation, key.first) != 0) {
+            const Statistic &operation = operations.value(QByteArray(key.first));
+            stream << key.first << ", " << operation.count << ", "
+                   << operation.totalNsecs / 1000 << ", " << operation.maxNsecs / 1000 << "\n";
+            last_operation = key.first;
+        }
+
+        const Statistic &site = data.value(key);
+        stream << "    " << fileName(key.second) << ", " << site.count << ", "
+               << site.totalNsecs / 1000 << ", " << site.maxNsecs / 1000 << "\n";
+    }
+
+    return text;
+}
+
+void DXcbRoundTrip::dump()
+{
+    if (!lcRoundTrip().isInfoEnabled())
+        return;
+
+    const QString text = report(false);
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
+    const QStringList lines = text.split('\n', QString::SkipEmptyParts);
+#else
+    const QStringList lines = text.split('\n', Qt::SkipEmptyParts);
+#endif
+
+    for (const QString &line : lines)
+        qCInfo(lcRoundTrip).noquote() << line;
+}
+
+DPP_END_NAMESPACE
+#endif
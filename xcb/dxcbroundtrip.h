@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: 2023 UnionTech Software Technology Co., Ltd.
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#ifndef DXCBROUNDTRIP_H
+#define DXCBROUNDTRIP_H
+
+#include "global.h"
+
+/*
+ * 统计同步等待X服务器回复(xcb_*_reply、xcb_request_check)的次数及耗时
+ * 使用 -DDXCB_ROUNDTRIP_STATS=ON 编译时才会启用，否则以下宏不会产生任何代码
+ *
+ * D_XCB_ROUNDTRIP(call): 包裹一次会阻塞的调用，以调用所在的文件和行号为统计单位
+ * D_XCB_ROUNDTRIP_OPERATION(name): 在当前作用域内，将所有往返归类到名为name的操作
+ */
+#ifdef DXCB_ROUNDTRIP_STATS
+#include <QElapsedTimer>
+#include <QString>
+
+DPP_BEGIN_NAMESPACE
+
+class DXcbRoundTrip
+{
+public:
+    class Operation
+    {
+    public:
+        explicit Operation(const char *name);
+        ~Operation();
+
+    private:
+        const char *m_previous;
+    };
+
+    template<typename Fun>
+    static inline auto measure(const char *site, Fun fun) -> decltype(fun())
+    {
+        QElapsedTimer timer;
+        timer.start();
+        auto result = fun();
+        record(site, timer.nsecsElapsed());
+
+        return result;
+    }
+
+    static void record(const char *site, qint64 nsecs);
+    static QString report(bool reset);
+    static void dump();
+};
+
+DPP_END_NAMESPACE
+
+#define D_XCB_ROUNDTRIP(call) \
+    deepin_platform_plugin::DXcbRoundTrip::measure(__FILE__ ":" QT_STRINGIFY(__LINE__), [&]() { return call; })
+#define D_XCB_ROUNDTRIP_OPERATION(name) \
+    deepin_platform_plugin::DXcbRoundTrip::Operation _d_xcb_roundtrip_operation(name)
+#else
+#define D_XCB_ROUNDTRIP(call) call
+#define D_XCB_ROUNDTRIP_OPERATION(name)
+#endif
+
+#endif // DXCBROUNDTRIP_H
@@ -6,6 +6,7 @@
 #include "dplatformintegration.h"
 #include "utility.h"
 #include "dframewindow.h"
+#include "dxcbroundtrip.h"
 
 #include "qxcbconnection.h"
 #define private public
@@ -25,14 +26,10 @@ DXcbWMSupport::DXcbWMSupport()
     updateWMName(false);
 
     connect(this, &DXcbWMSupport::windowMotifWMHintsChanged, this, [this] (quint32 winId) {
-        for (const DFrameWindow *frame : DFrameWindow::frameWindowList) {
-            if (frame->m_contentWindow && frame->m_contentWindow->handle()
-                    && static_cast<QXcbWindow*>(frame->m_contentWindow->handle())->QXcbWindow::winId() == winId) {
-                if (frame->handle())
-                    emit windowMotifWMHintsChanged(frame->handle()->winId());
-                break;
-            }
-        }
+        const DFrameWindow *frame = DFrameWindow::findByClientWinId(winId);
+
+        if (frame && frame->handle())
+            emit windowMotifWMHintsChanged(frame->handle()->winId());
     });
 }
 
@@ -40,6 +37,7 @@ void DXcbWMSupport::updateWMName(bool emitSignal)
 {
     _net_wm_deepin_blur_region_rounded_atom = Utility::internAtom(QT_STRINGIFY(_NET_WM_DEEPIN_BLUR_REGION_ROUNDED), false);
     _net_wm_deepin_blur_region_mask = Utility::internAtom(QT_STRINGIFY(_NET_WM_DEEPIN_BLUR_REGION_MASK), false);
+    _net_wm_deepin_blur_region_mask_rle = Utility::internAtom(QT_STRINGIFY(_NET_WM_DEEPIN_BLUR_REGION_MASK_RLE), false);
     _kde_net_wm_blur_rehind_region_atom = Utility::internAtom(QT_STRINGIFY(_KDE_NET_WM_BLUR_BEHIND_REGION), false);
     _deepin_wallpaper = Utility::internAtom(QT_STRINGIFY(_DEEPIN_WALLPAPER), false);
     _deepin_wallpaper_shared_key = Utility::internAtom(QT_STRINGIFY(_DEEPIN_WALLPAPER_SHARED_MEMORY), false);
@@ -52,20 +50,20 @@ void DXcbWMSupport::updateWMName(bool emitSignal)
     xcb_window_t root = DPlatformIntegration::xcbConnection()->primaryScreen()->root();
 
     xcb_get_property_reply_t *reply =
-        xcb_get_property_reply(xcb_connection,
+        D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection,
             xcb_get_property_unchecked(xcb_connection, false, root,
                              DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_NET_SUPPORTING_WM_CHECK)),
-                             XCB_ATOM_WINDOW, 0, 1024), NULL);
+                             XCB_ATOM_WINDOW, 0, 1024), NULL));
 
     if (reply && reply->format == 32 && reply->type == XCB_ATOM_WINDOW) {
         xcb_window_t windowManager = *((xcb_window_t *)xcb_get_property_value(reply));
 
         if (windowManager != XCB_WINDOW_NONE) {
             xcb_get_property_reply_t *windowManagerReply =
-                xcb_get_property_reply(xcb_connection,
+                D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection,
                     xcb_get_property_unchecked(xcb_connection, false, windowManager,
                                      DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_NET_WM_NAME)),
-                                     DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(UTF8_STRING)), 0, 1024), NULL);
+                                     DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(UTF8_STRING)), 0, 1024), NULL));
             if (windowManagerReply && windowManagerReply->format == 8
                     && windowManagerReply->type == DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(UTF8_STRING))) {
                 m_wmName = QString::fromUtf8((const char *)xcb_get_property_value(windowManagerReply), xcb_get_property_value_length(windowManagerReply));
@@ -78,6 +76,7 @@ void DXcbWMSupport::updateWMName(bool emitSignal)
 
     m_isDeepinWM = (m_wmName == QStringLiteral("Mutter(DeepinGala)"));
     m_isKwin = !m_isDeepinWM && (m_wmName == QStringLiteral("KWin"));
+    m_isOpenbox = m_wmName == QStringLiteral("Openbox");
 
     updateHasComposite();
     updateNetWMAtoms();
@@ -100,7 +99,7 @@ void DXcbWMSupport::updateNetWMAtoms()
         xcb_get_property_cookie_t cookie = xcb_get_property(xcb_connection, false, root,
                                                             DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_NET_SUPPORTED)),
                                                             XCB_ATOM_ATOM, offset, 1024);
-        xcb_get_property_reply_t *reply = xcb_get_property_reply(xcb_connection, cookie, NULL);
+        xcb_get_property_reply_t *reply = D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection, cookie, NULL));
         if (!reply)
             break;
 
@@ -134,7 +133,7 @@ void DXcbWMSupport::updateRootWindowProperties()
     xcb_connection_t *xcb_connection = DPlatformIntegration::xcbConnection()->xcb_connection();
 
     xcb_list_properties_cookie_t cookie = xcb_list_properties(xcb_connection, root);
-    xcb_list_properties_reply_t *reply = xcb_list_properties_reply(xcb_connection, cookie, NULL);
+    xcb_list_properties_reply_t *reply = D_XCB_ROUNDTRIP(xcb_list_properties_reply(xcb_connection, cookie, NULL));
 
     if (!reply)
         return;
@@ -174,8 +173,8 @@ void DXcbWMSupport::updateHasComposite()
     xcb_window_t root = DPlatformIntegration::xcbConnection()->primaryScreen()->root();
 
     //stage1: check if _NET_KDE_COMPOSITE_TOGGLING is supported
-    xcb_get_property_reply_t *reply = xcb_get_property_reply(xcb_connection,
-            xcb_get_property_unchecked(xcb_connection, false, root, atom, atom, 0, 1), NULL);
+    xcb_get_property_reply_t *reply = D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection,
+            xcb_get_property_unchecked(xcb_connection, false, root, atom, atom, 0, 1), NULL));
     if (reply && reply->type != XCB_NONE) {
         int value = 0;
         if (reply->type == atom && reply->format == 8) {
@@ -192,7 +191,7 @@ void DXcbWMSupport::updateHasComposite()
     } else {
         //stage2: fallback to check selection owner
         xcb_get_selection_owner_cookie_t cookit = xcb_get_selection_owner(xcb_connection, DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_NET_WM_CM_S0)));
-        xcb_get_selection_owner_reply_t *reply = xcb_get_selection_owner_reply(xcb_connection, cookit, NULL);
+        xcb_get_selection_owner_reply_t *reply = D_XCB_ROUNDTRIP(xcb_get_selection_owner_reply(xcb_connection, cookit, NULL));
         if (!reply)
             return;
 
@@ -323,23 +322,101 @@ bool DXcbWMSupport::connectWindowMotifWMHintsChanged(QObject *object, std::funct
     return QObject::connect(globalXWMS, &DXcbWMSupport::windowMotifWMHintsChanged, object, slot);
 }
 
+static bool isOwnWindow(quint32 winId)
+{
+    return DPlatformIntegration::xcbConnection()->platformWindowFromId(winId);
+}
+
+// 与 Utility::setMotifWmHints 中的处理保持一致，得到写入后再读取时的值
+static Utility::QtMotifWmHints normalizeMotifWmHints(Utility::QtMotifWmHints hints)
+{
+    if (hints.flags == 0l) {
+        hints.functions = DXcbWMSupport::MWM_FUNC_ALL;
+        hints.decorations = DXcbWMSupport::MWM_DECOR_ALL;
+        hints.input_mode = 0L;
+        hints.status = 0L;
+
+        return hints;
+    }
+
+    if (hints.functions & DXcbWMSupport::MWM_FUNC_ALL)
+        hints.functions = DXcbWMSupport::MWM_FUNC_ALL;
+
+    if (hints.decorations & DXcbWMSupport::MWM_DECOR_ALL)
+        hints.decorations = DXcbWMSupport::MWM_DECOR_ALL;
+
+    return hints;
+}
+
+Utility::QtMotifWmHints DXcbWMSupport::motifWmHints(quint32 winId)
+{
+    auto cache = instance()->m_motifWmHints.constFind(winId);
+
+    if (cache != instance()->m_motifWmHints.constEnd())
+        return cache->hints;
+
+    Utility::QtMotifWmHints hints = Utility::getMotifWmHints(winId);
+
+    if (isOwnWindow(winId))
+        instance()->m_motifWmHints[winId].hints = hints;
+
+    return hints;
+}
+
+void DXcbWMSupport::setMotifWmHints(quint32 winId, Utility::QtMotifWmHints hints)
+{
+    Utility::setMotifWmHints(winId, hints);
+
+    if (!isOwnWindow(winId))
+        return;
+
+    MotifWmHintsCache &cache = instance()->m_motifWmHints[winId];
+    cache.hints = normalizeMotifWmHints(hints);
+
+    // 删除一个不存在的属性时不会产生 PropertyNotify 事件，因此只记录修改属性的操作
+    if (hints.flags != 0l)
+        ++cache.pendingWrites;
+}
+
+void DXcbWMSupport::updateMotifWmHints(quint32 winId)
+{
+    auto cache = m_motifWmHints.find(winId);
+
+    if (cache == m_motifWmHints.end())
+        return;
+
+    // 由自己写入引起的变化，缓存中已经是最新的值
+    if (cache->pendingWrites > 0) {
+        --cache->pendingWrites;
+        return;
+    }
+
+    // 其它地方修改了此属性，下次使用时再重新读取
+    m_motifWmHints.erase(cache);
+}
+
+void DXcbWMSupport::removeMotifWmHints(quint32 winId)
+{
+    m_motifWmHints.remove(winId);
+}
+
 void DXcbWMSupport::setMWMFunctions(quint32 winId, quint32 func)
 {
     // FIXME(zccrs): The Openbox window manager does not support the Motif Hints
-    if (instance()->windowManagerName() == "Openbox")
+    if (instance()->m_isOpenbox)
         return;
 
-    Utility::QtMotifWmHints hints = Utility::getMotifWmHints(winId);
+    Utility::QtMotifWmHints hints = motifWmHints(winId);
 
     hints.flags |= MWM_HINTS_FUNCTIONS;
     hints.functions = func;
 
-    Utility::setMotifWmHints(winId, hints);
+    setMotifWmHints(winId, hints);
 }
 
 quint32 DXcbWMSupport::getMWMFunctions(quint32 winId)
 {
-    Utility::QtMotifWmHints hints = Utility::getMotifWmHints(winId);
+    Utility::QtMotifWmHints hints = motifWmHints(winId);
 
     if (hints.flags & MWM_HINTS_FUNCTIONS)
         return hints.functions;
@@ -349,12 +426,10 @@ quint32 DXcbWMSupport::getMWMFunctions(quint32 winId)
 
 quint32 DXcbWMSupport::getRealWinId(quint32 winId)
 {
-    for (const DFrameWindow *frame : DFrameWindow::frameWindowList) {
-        if (frame->handle() && frame->handle()->winId() == winId
-                && frame->m_contentWindow && frame->m_contentWindow->handle()) {
-            return static_cast<QXcbWindow*>(frame->m_contentWindow->handle())->QXcbWindow::winId();
-        }
-    }
+    const DFrameWindow *frame = DFrameWindow::findByFrameWinId(winId);
+
+    if (frame && frame->m_contentWindow && frame->m_contentWindow->handle())
+        return static_cast<QXcbWindow*>(frame->m_contentWindow->handle())->QXcbWindow::winId();
 
     return winId;
 }
@@ -363,19 +438,19 @@ void DXcbWMSupport::setMWMDecorations(quint32 winId, quint32 decor)
 {
     winId = getRealWinId(winId);
 
-    Utility::QtMotifWmHints hints = Utility::getMotifWmHints(winId);
+    Utility::QtMotifWmHints hints = motifWmHints(winId);
 
     hints.flags |= MWM_HINTS_DECORATIONS;
     hints.decorations = decor;
 
-    Utility::setMotifWmHints(winId, hints);
+    setMotifWmHints(winId, hints);
 }
 
 quint32 DXcbWMSupport::getMWMDecorations(quint32 winId)
 {
     winId = getRealWinId(winId);
 
-    Utility::QtMotifWmHints hints = Utility::getMotifWmHints(winId);
+    Utility::QtMotifWmHints hints = motifWmHints(winId);
 
     if (hints.flags & MWM_HINTS_DECORATIONS)
         return hints.decorations;
@@ -406,7 +481,7 @@ QVector<xcb_window_t> DXcbWMSupport::allWindow() const
         xcb_get_property_cookie_t cookie = xcb_get_property(xcb_connection, false, root,
                                                             Utility::internAtom("_NET_CLIENT_LIST_STACKING"),
                                                             XCB_ATOM_WINDOW, offset, 1024);
-        xcb_get_property_reply_t *reply = xcb_get_property_reply(xcb_connection, cookie, NULL);
+        xcb_get_property_reply_t *reply = D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection, cookie, NULL));
         if (!reply)
             break;
 
@@ -451,7 +526,7 @@ xcb_window_t DXcbWMSupport::windowFromPoint(const QPoint &p) const
     int16_t x = static_cast<int16_t>(p.x());
     int16_t y = static_cast<int16_t>(p.y());
 
-    auto translate_reply = Q_XCB_REPLY_UNCHECKED(xcb_translate_coordinates, xcb_connection, parent, child, x, y);
+    auto translate_reply = D_XCB_ROUNDTRIP(Q_XCB_REPLY_UNCHECKED(xcb_translate_coordinates, xcb_connection, parent, child, x, y));
     if (!translate_reply) {
         return wid;
     }
@@ -6,9 +6,11 @@
 #define DXCBWMSUPPORT_H
 
 #include "global.h"
+#include "utility.h"
 
 #include <QObject>
 #include <QVector>
+#include <QHash>
 
 #include <xcb/xcb.h>
 
@@ -128,13 +130,19 @@ private:
     void updateHasNoTitlebar();
     void updateHasScissorWindow();
     void updateWallpaperEffect();
+    void updateMotifWmHints(quint32 winId);
+    void removeMotifWmHints(quint32 winId);
 
     qint8 getHasWindowAlpha() const;
 
+    static Utility::QtMotifWmHints motifWmHints(quint32 winId);
+    static void setMotifWmHints(quint32 winId, Utility::QtMotifWmHints hints);
+
     static quint32 getRealWinId(quint32 winId);
 
     bool m_isDeepinWM = false;
     bool m_isKwin = false;
+    bool m_isOpenbox = false;
     bool m_hasBlurWindow = false;
     bool m_hasComposite = false;
     bool m_hasNoTitlebar = false;
@@ -147,6 +155,7 @@ private:
     xcb_atom_t _net_wm_deepin_blur_region_rounded_atom = 0;
     xcb_atom_t _kde_net_wm_blur_rehind_region_atom = 0;
     xcb_atom_t _net_wm_deepin_blur_region_mask = 0;
+    xcb_atom_t _net_wm_deepin_blur_region_mask_rle = 0;
     xcb_atom_t _deepin_wallpaper = 0;
     xcb_atom_t _deepin_wallpaper_shared_key = 0;
     xcb_atom_t _deepin_no_titlebar = 0;
@@ -155,6 +164,14 @@ private:
     QVector<xcb_atom_t> net_wm_atoms;
     QVector<xcb_atom_t> root_window_properties;
 
+    struct MotifWmHintsCache {
+        Utility::QtMotifWmHints hints;
+        // 由本进程写入但还未收到 PropertyNotify 的次数
+        int pendingWrites = 0;
+    };
+    // 只缓存本进程创建的窗口，这些窗口的属性变化一定会通过 PropertyNotify 通知到
+    QHash<quint32, MotifWmHintsCache> m_motifWmHints;
+
     friend class XcbNativeEventFilter;
     friend class Utility;
     friend class DBackingStoreProxy;
@@ -16,6 +16,7 @@ QT_END_NAMESPACE
 
 typedef uint32_t xcb_atom_t;
 typedef struct xcb_connection_t xcb_connection_t;
+typedef struct xcb_rectangle_t xcb_rectangle_t;
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
 #define D_QXCBATOM_WRAPPER(AtomEnum) Atom##AtomEnum
@@ -40,6 +41,8 @@ public:
     };
 
     static QImage dropShadow(const QPixmap &px, qreal radius, const QColor &color);
+    // 圆角矩形的阴影，由缓存的九宫格图块拼接而成，size 为圆角矩形的大小（设备像素）
+    static QImage roundedRectShadow(const QSize &size, qreal cornerRadius, qreal radius, const QColor &color);
     static QImage borderImage(const QPixmap &px, const QMargins &borders, const QSize &size,
                               QImage::Format format = QImage::Format_ARGB32_Premultiplied);
 
@@ -47,6 +50,8 @@ public:
 
     static xcb_atom_t internAtom(const char *name, bool only_if_exists = true);
     static xcb_atom_t internAtom(xcb_connection_t *connection, const char *name, bool only_if_exists = true);
+    // 以流水线的方式一次性申请插件中用到的所有atom，之后的internAtom调用将直接命中缓存
+    static void prefetchAtoms(xcb_connection_t *connection);
     static void startWindowSystemMove(quint32 WId);
     static void cancelWindowMoveResize(quint32 WId);
 
@@ -114,6 +119,8 @@ public:
     static bool blurWindowBackgroundByPaths(const quint32 WId, const QList<QPainterPath> &paths);
     static bool blurWindowBackgroundByImage(const quint32 WId, const QRect &blurRect, const QImage &maskImage);
     static void clearWindowBlur(const quint32 WId);
+    // 窗口销毁后丢弃为其缓存的模糊区域属性，不会向X server发送请求
+    static void removeWindowBlurCache(const quint32 WId);
     static bool updateBackgroundWallpaper(const quint32 WId, const QRect &area, const quint32 bMode);
     static void clearWindowBackground(const quint32 WId);
 
@@ -131,6 +138,9 @@ public:
     static QtMotifWmHints getMotifWmHints(quint32 WId);
     static void setMotifWmHints(quint32 WId, QtMotifWmHints hints);
     static quint32 getNativeTopLevelWindow(quint32 WId);
+    // 窗口被重新设置父窗口、销毁或motif hints变化时，需要使缓存的顶层窗口失效
+    static void invalidateNativeTopLevelWindow(quint32 WId);
+    static void clearNativeTopLevelWindowCache();
 
     static QPoint translateCoordinates(const QPoint &pos, quint32 src, quint32 dst);
     static QRect windowGeometry(quint32 WId);
@@ -148,6 +158,7 @@ private:
     static void sendMoveResizeMessage(quint32 WId, uint32_t action, QPoint globalPos = QPoint(), Qt::MouseButton qbutton = Qt::LeftButton);
     static QWindow *getWindowById(quint32 WId);
     static qreal getWindowDevicePixelRatio(quint32 WId);
+    static QVector<xcb_rectangle_t> shapePathRectangles(const QPainterPath &path);
 };
 
 DPP_END_NAMESPACE
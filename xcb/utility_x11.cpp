@@ -8,6 +8,7 @@
 
 #include "dplatformintegration.h"
 #include "dxcbwmsupport.h"
+#include "dxcbroundtrip.h"
 
 #include <QPixmap>
 #include <QPainter>
@@ -20,9 +21,17 @@
 #endif
 
 #include <QGuiApplication>
+#include <QCache>
+#include <QMutex>
+#include <QtMath>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QVarLengthArray>
 #include <qpa/qplatformwindow.h>
 #include <qpa/qplatformcursor.h>
 
+#include <algorithm>
+
 #if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
 #include <QtWidgets/qtwidgetsglobal.h>
 #endif
@@ -41,44 +50,205 @@
 #define XDEEPIN_BLUR_REGION_ROUNDED "_NET_WM_DEEPIN_BLUR_REGION_ROUNDED"
 #define _GTK_SHOW_WINDOW_MENU "_GTK_SHOW_WINDOW_MENU"
 
-QT_BEGIN_NAMESPACE
-//extern Q_WIDGETS_EXPORT void qt_blurImage(QImage &blurImage, qreal radius, bool quality, int transposed = 0);
-extern Q_WIDGETS_EXPORT void qt_blurImage(QPainter *p, QImage &blurImage, qreal radius, bool quality, bool alphaOnly, int transposed = 0);
-QT_END_NAMESPACE
-
 DPP_BEGIN_NAMESPACE
 
+// 对 Alpha8 图像的每一行执行盒式模糊，使用滑动窗口使开销与半径无关，图像外部视为透明
+static void boxBlurRows(const QImage &src, QImage &dst, int r)
+{
+    const int width = src.width();
+    const quint32 mul = (1u << 16) / quint32(2 * r + 1);
+
+    for (int y = 0; y < src.height(); ++y) {
+        const uchar *in = src.constScanLine(y);
+        uchar *out = dst.scanLine(y);
+        quint32 acc = 0;
+
+        for (int x = 0; x < qMin(r, width); ++x)
+            acc += in[x];
+
+        for (int x = 0; x < width; ++x) {
+            if (x + r < width)
+                acc += in[x + r];
+
+            out[x] = uchar((acc * mul + (1u << 15)) >> 16);
+
+            if (x >= r)
+                acc -= in[x - r];
+        }
+    }
+}
+
+// 按行推进一组列累加器，内层循环在连续内存上进行，便于编译器向量化
+static void boxBlurColumns(const QImage &src, QImage &dst, int r)
+{
+    const int width = src.width();
+    const int height = src.height();
+    const quint32 mul = (1u << 16) / quint32(2 * r + 1);
+    QVarLengthArray<quint32, 1024> acc(width);
+
+    std::fill(acc.begin(), acc.end(), 0u);
+
+    for (int y = 0; y < qMin(r, height); ++y) {
+        const uchar *in = src.constScanLine(y);
+
+        for (int x = 0; x < width; ++x)
+            acc[x] += in[x];
+    }
+
+    for (int y = 0; y < height; ++y) {
+        if (y + r < height) {
+            const uchar *in = src.constScanLine(y + r);
+
+            for (int x = 0; x < width; ++x)
+                acc[x] += in[x];
+        }
+
+        uchar *out = dst.scanLine(y);
+
+        for (int x = 0; x < width; ++x)
+            out[x] = uchar((acc[x] * mul + (1u << 15)) >> 16);
+
+        if (y >= r) {
+            const uchar *in = src.constScanLine(y - r);
+
+            for (int x = 0; x < width; ++x)
+                acc[x] -= in[x];
+        }
+    }
+}
+
+// 三次盒式模糊近似高斯模糊，总扩散范围不超过 radius
+static void blurAlpha(QImage &alpha, qreal radius)
+{
+    // 向下取整，保证三次模糊的扩散范围 3 * r 不超出调用者预留的 int(radius) 的边距
+    const int r = int(radius / 3);
+
+    if (r <= 0 || alpha.isNull())
+        return;
+
+    QImage tmp(alpha.size(), QImage::Format_Alpha8);
+
+    boxBlurRows(alpha, tmp, r);
+    boxBlurRows(tmp, alpha, r);
+    boxBlurRows(alpha, tmp, r);
+    boxBlurColumns(tmp, alpha, r);
+    boxBlurColumns(alpha, tmp, r);
+    boxBlurColumns(tmp, alpha, r);
+}
+
+// 等价于先绘制模糊后的 alpha 通道，再以 SourceIn 的方式填充 color
+static QImage colorizeAlpha(const QImage &alpha, const QColor &color)
+{
+    QImage image(alpha.size(), QImage::Format_ARGB32_Premultiplied);
+    QRgb table[256];
+    const QRgb rgba = color.rgba();
+
+    for (int i = 0; i < 256; ++i) {
+        table[i] = qPremultiply(qRgba(qRed(rgba), qGreen(rgba), qBlue(rgba), qAlpha(rgba) * i / 255));
+    }
+
+    for (int y = 0; y < alpha.height(); ++y) {
+        const uchar *in = alpha.constScanLine(y);
+        QRgb *out = reinterpret_cast<QRgb*>(image.scanLine(y));
+
+        for (int x = 0; x < alpha.width(); ++x)
+            out[x] = table[in[x]];
+    }
+
+    return image;
+}
+
 QImage Utility::dropShadow(const QPixmap &px, qreal radius, const QColor &color)
 {
     if (px.isNull())
         return QImage();
 
-    QImage tmp(px.size() + QSize(radius * 2, radius * 2), QImage::Format_ARGB32_Premultiplied);
-    tmp.fill(0);
-    QPainter tmpPainter(&tmp);
-    tmpPainter.setCompositionMode(QPainter::CompositionMode_Source);
-    tmpPainter.drawPixmap(QPoint(radius, radius), px);
-    tmpPainter.end();
+    const int padding = int(radius);
+    QImage alpha(px.size() + QSize(padding * 2, padding * 2), QImage::Format_Alpha8);
+    alpha.fill(0);
+    QPainter pa(&alpha);
+    pa.setCompositionMode(QPainter::CompositionMode_Source);
+    pa.drawPixmap(QPoint(padding, padding), px);
+    pa.end();
 
-    // blur the alpha channel
-    QImage blurred(tmp.size(), QImage::Format_ARGB32_Premultiplied);
-    blurred.fill(0);
-    QPainter blurPainter(&blurred);
-    qt_blurImage(&blurPainter, tmp, radius, false, true);
-    blurPainter.end();
+    blurAlpha(alpha, radius);
 
-    if (color == QColor(Qt::black))
-        return blurred;
+    return colorizeAlpha(alpha, color);
+}
 
-    tmp = blurred;
+namespace {
+struct ShadowTileCache {
+    QMutex mutex;
+    // 以KB为单位的缓存开销
+    QCache<quint64, QImage> tiles { 8 * 1024 };
+};
+}
 
-    // blacken the image...
-    tmpPainter.begin(&tmp);
-    tmpPainter.setCompositionMode(QPainter::CompositionMode_SourceIn);
-    tmpPainter.fillRect(tmp.rect(), color);
-    tmpPainter.end();
+Q_GLOBAL_STATIC(ShadowTileCache, shadowTileCache)
 
-    return tmp;
+QImage Utility::roundedRectShadow(const QSize &size, qreal cornerRadius, qreal radius, const QColor &color)
+{
+    if (size.isEmpty())
+        return QImage();
+
+    const int padding = int(radius);
+    const int corner = qCeil(qMax(cornerRadius, 0.0));
+    // 距矩形边缘超过 edge 的区域不再受圆角和模糊的影响，阴影沿边缘方向保持不变
+    const int edge = corner + padding;
+    const int tile_size = 2 * edge + 1;
+
+    auto shadowOfRoundedRect = [&] (const QSize &rectSize) {
+        QImage alpha(rectSize + QSize(padding * 2, padding * 2), QImage::Format_Alpha8);
+        alpha.fill(0);
+        QPainterPath path;
+        path.addRoundedRect(QRectF(QPointF(padding, padding), rectSize), cornerRadius, cornerRadius);
+        QPainter pa(&alpha);
+        pa.fillPath(path, color);
+        pa.end();
+
+        blurAlpha(alpha, radius);
+
+        return colorizeAlpha(alpha, color);
+    };
+
+    // 窗口过小时无法进行九宫格拉伸
+    if (size.width() < tile_size || size.height() < tile_size)
+        return shadowOfRoundedRect(size);
+
+    const quint64 key = (quint64(qBound(0, qRound(radius * 16), 0xffff)) << 48)
+            | (quint64(qBound(0, qRound(cornerRadius * 16), 0xffff)) << 32) | color.rgba();
+    QImage tile;
+
+    {
+        QMutexLocker locker(&shadowTileCache->mutex);
+
+        if (const QImage *cached = shadowTileCache->tiles.object(key))
+            tile = *cached;
+    }
+
+    if (tile.isNull()) {
+        tile = shadowOfRoundedRect(QSize(tile_size, tile_size));
+
+        QMutexLocker locker(&shadowTileCache->mutex);
+        shadowTileCache->tiles.insert(key, new QImage(tile), qMax(1, int(tile.sizeInBytes() / 1024)));
+    }
+
+    const QSize target_size = size + QSize(padding * 2, padding * 2);
+    const QMargins borders(padding + edge, padding + edge, padding + edge, padding + edge);
+    const QList<QRect> sudoku_src = sudokuByRect(tile.rect(), borders);
+    const QList<QRect> sudoku_tar = sudokuByRect(QRect(QPoint(0, 0), target_size), borders);
+
+    QImage image(target_size, QImage::Format_ARGB32_Premultiplied);
+    QPainter pa(&image);
+    pa.setCompositionMode(QPainter::CompositionMode_Source);
+
+    for (int i = 0; i < 9; ++i) {
+        pa.drawImage(sudoku_tar[i], tile, sudoku_src[i]);
+    }
+
+    pa.end();
+
+    return image;
 }
 
 QList<QRect> Utility::sudokuByRect(const QRect &rect, QMargins borders)
@@ -134,20 +304,104 @@ QImage Utility::borderImage(const QPixmap &px, const QMargins &borders,
     return image;
 }
 
+namespace {
+struct AtomCache {
+    QReadWriteLock lock;
+    xcb_connection_t *connection = nullptr;
+    QHash<QByteArray, xcb_atom_t> atoms;
+};
+
+struct KnownAtom {
+    const char *name;
+    bool onlyIfExists;
+};
+
+// 插件中各处通过 Utility::internAtom 使用的atom，在插件初始化时一次性申请
+const KnownAtom knownAtoms[] = {
+    { "_NET_WM_MOVERESIZE", true },
+    { "_NET_WM_DESKTOP", true },
+    { "_NET_CURRENT_DESKTOP", true },
+    { "_NET_CLIENT_LIST_STACKING", true },
+    { "_NET_KDE_COMPOSITE_TOGGLING", true },
+    { "_NET_WM_STATE_HIDDEN", true },
+    { "_GTK_FRAME_EXTENTS", true },
+    { "_GTK_SHOW_WINDOW_MENU", true },
+    { "_DEEPIN_MOVE_UPDATE", true },
+    { "_DEEPIN_NET_SUPPORTED", true },
+    { "_DEEPIN_FORCE_DECORATE", false },
+    { "_DEEPIN_SPLIT_WINDOW", false },
+    { "_DEEPIN_SCISSOR_WINDOW", false },
+    { "_DEEPIN_NO_TITLEBAR", false },
+    { "_DEEPIN_WALLPAPER", false },
+    { "_DEEPIN_WALLPAPER_SHARED_MEMORY", false },
+    { "_DEEPIN_DXCB_SHM_INFO", false },
+    { "_NET_WM_DEEPIN_BLUR_REGION_ROUNDED", false },
+    { "_NET_WM_DEEPIN_BLUR_REGION_MASK", false },
+    { "_NET_WM_DEEPIN_BLUR_REGION_MASK_RLE", false },
+    { "_KDE_NET_WM_BLUR_BEHIND_REGION", false },
+};
+}
+
+Q_GLOBAL_STATIC(AtomCache, atomCache)
+
+static bool findCachedAtom(xcb_connection_t *connection, const QByteArray &name, xcb_atom_t *atom)
+{
+    QReadLocker locker(&atomCache->lock);
+
+    if (atomCache->connection != connection)
+        return false;
+
+    auto it = atomCache->atoms.constFind(name);
+
+    if (it == atomCache->atoms.constEnd())
+        return false;
+
+    *atom = it.value();
+
+    return true;
+}
+
+static void insertCachedAtom(xcb_connection_t *connection, const QByteArray &name, xcb_atom_t atom)
+{
+    // 不存在的atom不能缓存：其它客户端(如拖放的来源程序)随时可能创建它，
+    // 缓存XCB_NONE会让本进程在之后一直认为它不存在
+    if (atom == XCB_NONE)
+        return;
+
+    QWriteLocker locker(&atomCache->lock);
+
+    if (!atomCache->connection)
+        atomCache->connection = connection;
+
+    if (atomCache->connection != connection)
+        return;
+
+    atomCache->atoms.insert(name, atom);
+}
+
 xcb_atom_t Utility::internAtom(xcb_connection_t *connection, const char *name, bool only_if_exists)
 {
     if (!name || *name == 0)
         return XCB_NONE;
 
-    xcb_intern_atom_cookie_t cookie = xcb_intern_atom(connection, only_if_exists, strlen(name), name);
-    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(connection, cookie, 0);
+    const QByteArray key = QByteArray::fromRawData(name, int(strlen(name)));
+    xcb_atom_t atom = XCB_NONE;
+
+    if (findCachedAtom(connection, key, &atom))
+        return atom;
+
+    xcb_intern_atom_cookie_t cookie = xcb_intern_atom(connection, only_if_exists, key.size(), name);
+    xcb_intern_atom_reply_t *reply = D_XCB_ROUNDTRIP(xcb_intern_atom_reply(connection, cookie, 0));
 
     if (!reply)
         return XCB_NONE;
 
-    xcb_atom_t atom = reply->atom;
+    atom = reply->atom;
     free(reply);
 
+    // fromRawData 不持有数据，存入缓存时需要深拷贝
+    insertCachedAtom(connection, QByteArray(name), atom);
+
     return atom;
 }
 
@@ -156,6 +410,31 @@ xcb_atom_t Utility::internAtom(const char *name, bool only_if_exists)
     return internAtom(QX11Info::connection(), name, only_if_exists);
 }
 
+void Utility::prefetchAtoms(xcb_connection_t *connection)
+{
+    if (!connection)
+        return;
+
+    const int count = int(sizeof(knownAtoms) / sizeof(knownAtoms[0]));
+    QVarLengthArray<xcb_intern_atom_cookie_t, 32> cookies(count);
+
+    // 先发出所有请求再等待回复，整个过程只需一次往返
+    for (int i = 0; i < count; ++i) {
+        const KnownAtom &known = knownAtoms[i];
+        cookies[i] = xcb_intern_atom(connection, known.onlyIfExists, strlen(known.name), known.name);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        xcb_intern_atom_reply_t *reply = D_XCB_ROUNDTRIP(xcb_intern_atom_reply(connection, cookies[i], 0));
+
+        if (!reply)
+            continue;
+
+        insertCachedAtom(connection, QByteArray(knownAtoms[i].name), reply->atom);
+        free(reply);
+    }
+}
+
 void Utility::startWindowSystemMove(quint32 WId)
 {
     sendMoveResizeMessage(WId, _NET_WM_MOVERESIZE_MOVE);
@@ -257,6 +536,367 @@ static QVector<xcb_rectangle_t> qregion2XcbRectangles(const QRegion &region)
     return rectangles;
 }
 
+namespace {
+struct ShapeSpan
+{
+    int left;
+    int right;
+};
+
+typedef QVarLengthArray<ShapeSpan, 8> ShapeSpanList;
+
+/*!
+ * \brief 逐行接收像素区间，内容相同的相邻行合并为一个带(band)，
+ * 输出的矩形满足 XCB_CLIP_ORDERING_YX_BANDED 的要求
+ */
+class ShapeRectanglesBuilder
+{
+public:
+    void addRow(int y, const ShapeSpanList &spans)
+    {
+        if (spans.isEmpty()) {
+            flush();
+            return;
+        }
+
+        if (y == m_bandBottom && isSameSpans(spans)) {
+            ++m_bandBottom;
+            return;
+        }
+
+        flush();
+        m_spans = spans;
+        m_bandTop = y;
+        m_bandBottom = y + 1;
+    }
+
+    QVector<xcb_rectangle_t> finish()
+    {
+        flush();
+        return m_rectangles;
+    }
+
+private:
+    bool isSameSpans(const ShapeSpanList &spans) const
+    {
+        if (spans.size() != m_spans.size())
+            return false;
+
+        for (int i = 0; i < spans.size(); ++i) {
+            if (spans.at(i).left != m_spans.at(i).left || spans.at(i).right != m_spans.at(i).right)
+                return false;
+        }
+
+        return true;
+    }
+
+    void flush()
+    {
+        for (const ShapeSpan &span : m_spans) {
+            xcb_rectangle_t r;
+
+            r.x = span.left;
+            r.y = m_bandTop;
+            r.width = span.right - span.left;
+            r.height = m_bandBottom - m_bandTop;
+
+            m_rectangles << r;
+        }
+
+        m_spans.clear();
+    }
+
+    ShapeSpanList m_spans;
+    int m_bandTop = 0;
+    int m_bandBottom = 0;
+    QVector<xcb_rectangle_t> m_rectangles;
+};
+
+struct ShapeCacheEntry
+{
+    QPainterPath path;
+    QVector<xcb_rectangle_t> rectangles;
+};
+
+struct ShapeCache {
+    QMutex mutex;
+    // 缓存最近使用的窗口形状，调整窗口大小时同样的形状会被反复设置
+    QCache<quint64, ShapeCacheEntry> shapes { 32 };
+};
+}
+
+Q_GLOBAL_STATIC(ShapeCache, shapeCache)
+
+// 像素中心落在区间内时才填充此像素，与X服务器对多边形的处理保持一致
+static inline int spanEdge(qreal x)
+{
+    return qCeil(x - 0.5);
+}
+
+// 排序并合并重叠或相邻的区间
+static void normalizeSpans(ShapeSpanList &spans)
+{
+    if (spans.size() < 2)
+        return;
+
+    std::sort(spans.begin(), spans.end(), [](const ShapeSpan &a, const ShapeSpan &b) {
+        return a.left < b.left;
+    });
+
+    int last = 0;
+    for (int i = 1; i < spans.size(); ++i) {
+        if (spans.at(i).left <= spans.at(last).right) {
+            spans[last].right = qMax(spans.at(last).right, spans.at(i).right);
+        } else {
+            spans[++last] = spans.at(i);
+        }
+    }
+
+    spans.resize(last + 1);
+}
+
+/*!
+ * \brief 判断 path 是否是由 QPainterPath::addRoundedRect(或addRect)生成的圆角矩形
+ */
+static bool isRoundedRectPath(const QPainterPath &path, QRectF *rect, qreal *xRadius, qreal *yRadius)
+{
+    if (path.elementCount() < 5 || !path.elementAt(0).isMoveTo())
+        return false;
+
+    const QRectF bounds = path.boundingRect();
+    const QPainterPath::Element &first = path.elementAt(0);
+
+    // addRoundedRect 从左边圆角的末端(x, y + yRadius)开始，随后经过顶边的起点(x + xRadius, y)
+    if (!qFuzzyCompare(first.x + 1, bounds.left() + 1))
+        return false;
+
+    qreal y_radius = first.y - bounds.top();
+    // 无圆角时 addRoundedRect 等价于 addRect
+    qreal x_radius = 0;
+
+    for (int i = 0; i + 2 < path.elementCount(); ++i) {
+        if (path.elementAt(i).isCurveTo()) {
+            // 第一段曲线的终点
+            x_radius = path.elementAt(i + 2).x - bounds.left();
+            break;
+        }
+    }
+
+    if (x_radius < 0 || y_radius < 0)
+        return false;
+
+    QPainterPath rounded_rect;
+    rounded_rect.setFillRule(path.fillRule());
+    rounded_rect.addRoundedRect(bounds, x_radius, y_radius);
+
+    if (rounded_rect != path)
+        return false;
+
+    *rect = bounds;
+    *xRadius = x_radius;
+    *yRadius = y_radius;
+
+    return true;
+}
+
+// 圆角矩形每一行的左右边界可以直接计算得到
+static QVector<xcb_rectangle_t> roundedRectShapeRectangles(const QRectF &rect, qreal xRadius, qreal yRadius)
+{
+    ShapeRectanglesBuilder builder;
+    ShapeSpanList spans;
+    const int top = spanEdge(rect.top());
+    const int bottom = spanEdge(rect.bottom());
+    const qreal corner_top = rect.top() + yRadius;
+    const qreal corner_bottom = rect.bottom() - yRadius;
+
+    for (int y = top; y < bottom; ++y) {
+        const qreal yc = y + 0.5;
+        qreal dy = 0;
+
+        if (yc < corner_top)
+            dy = corner_top - yc;
+        else if (yc > corner_bottom)
+            dy = yc - corner_bottom;
+
+        qreal inset = 0;
+
+        if (dy > 0 && yRadius > 0) {
+            const qreal t = qMin(dy / yRadius, qreal(1));
+            inset = xRadius * (1 - qSqrt(1 - t * t));
+        }
+
+        const ShapeSpan span { spanEdge(rect.left() + inset), spanEdge(rect.right() - inset) };
+
+        spans.clear();
+        if (span.left < span.right)
+            spans.append(span);
+
+        builder.addRow(y, spans);
+    }
+
+    return builder.finish();
+}
+
+/*!
+ * \brief 扫描线方式将路径转换为YX-banded矩形，在每行像素中心处计算路径边界的交点
+ */
+static QVector<xcb_rectangle_t> rasterizeShapePath(const QPainterPath &path)
+{
+    struct Edge
+    {
+        qreal x;
+        qreal y0;
+        qreal y1;
+        qreal dxdy;
+        int winding;
+    };
+
+    QVector<Edge> edges;
+    qreal min_y = qInf();
+    qreal max_y = -qInf();
+
+    for (const QPolygonF &polygon : path.toSubpathPolygons()) {
+        const int count = polygon.size();
+
+        for (int i = 0; i < count; ++i) {
+            QPointF p0 = polygon.at(i);
+            QPointF p1 = polygon.at((i + 1) % count);
+
+            // 水平的边不会与扫描线相交
+            if (p0.y() == p1.y())
+                continue;
+
+            int winding = 1;
+
+            if (p0.y() > p1.y()) {
+                qSwap(p0, p1);
+                winding = -1;
+            }
+
+            edges.append({ p0.x(), p0.y(), p1.y(), (p1.x() - p0.x()) / (p1.y() - p0.y()), winding });
+            min_y = qMin(min_y, p0.y());
+            max_y = qMax(max_y, p1.y());
+        }
+    }
+
+    if (edges.isEmpty())
+        return QVector<xcb_rectangle_t>();
+
+    std::sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+        return a.y0 < b.y0;
+    });
+
+    const bool winding_fill = path.fillRule() == Qt::WindingFill;
+    const int top = spanEdge(min_y);
+    const int bottom = spanEdge(max_y);
+    ShapeRectanglesBuilder builder;
+    QVarLengthArray<const Edge*, 32> active_edges;
+    QVarLengthArray<QPair<qreal, int>, 32> crossings;
+    ShapeSpanList spans;
+    int next_edge = 0;
+
+    for (int y = top; y < bottom; ++y) {
+        const qreal yc = y + 0.5;
+
+        // 移除已经结束的边，加入新开始的边
+        int active_count = 0;
+        for (const Edge *edge : active_edges) {
+            if (edge->y1 > yc)
+                active_edges[active_count++] = edge;
+        }
+        active_edges.resize(active_count);
+
+        for (; next_edge < edges.size() && edges.at(next_edge).y0 <= yc; ++next_edge) {
+            if (edges.at(next_edge).y1 > yc)
+                active_edges.append(&edges.at(next_edge));
+        }
+
+        crossings.clear();
+        for (const Edge *edge : active_edges)
+            crossings.append(qMakePair(edge->x + (yc - edge->y0) * edge->dxdy, edge->winding));
+
+        std::sort(crossings.begin(), crossings.end(), [](const QPair<qreal, int> &a, const QPair<qreal, int> &b) {
+            return a.first < b.first;
+        });
+
+        spans.clear();
+        if (winding_fill) {
+            int winding = 0;
+            qreal start = 0;
+
+            for (const auto &crossing : crossings) {
+                const int previous = winding;
+                winding += crossing.second;
+
+                if (previous == 0 && winding != 0) {
+                    start = crossing.first;
+                } else if (previous != 0 && winding == 0) {
+                    const ShapeSpan span { spanEdge(start), spanEdge(crossing.first) };
+
+                    if (span.left < span.right)
+                        spans.append(span);
+                }
+            }
+        } else {
+            for (int i = 0; i + 1 < crossings.size(); i += 2) {
+                const ShapeSpan span { spanEdge(crossings.at(i).first), spanEdge(crossings.at(i + 1).first) };
+
+                if (span.left < span.right)
+                    spans.append(span);
+            }
+        }
+
+        normalizeSpans(spans);
+        builder.addRow(y, spans);
+    }
+
+    return builder.finish();
+}
+
+static quint64 shapeCacheKey(const QPainterPath &path)
+{
+    const QRect bounds = path.boundingRect().toAlignedRect();
+    uint seed = uint(qHash(int(path.fillRule())));
+
+    for (int i = 0; i < path.elementCount(); ++i) {
+        const QPainterPath::Element &e = path.elementAt(i);
+
+        seed = uint(qHash(e.x, seed));
+        seed = uint(qHash(e.y, seed));
+        seed = uint(qHash(int(e.type), seed));
+    }
+
+    return (quint64(seed) << 32) | (quint64(bounds.width() & 0xffff) << 16) | quint64(bounds.height() & 0xffff);
+}
+
+QVector<xcb_rectangle_t> Utility::shapePathRectangles(const QPainterPath &path)
+{
+    const quint64 key = shapeCacheKey(path);
+    ShapeCache *cache = shapeCache;
+
+    if (cache) {
+        QMutexLocker locker(&cache->mutex);
+        const ShapeCacheEntry *entry = cache->shapes.object(key);
+
+        if (entry && entry->path == path)
+            return entry->rectangles;
+    }
+
+    QRectF rect;
+    qreal x_radius = 0;
+    qreal y_radius = 0;
+    QVector<xcb_rectangle_t> rectangles = isRoundedRectPath(path, &rect, &x_radius, &y_radius)
+            ? roundedRectShapeRectangles(rect, x_radius, y_radius)
+            : rasterizeShapePath(path);
+
+    if (cache) {
+        QMutexLocker locker(&cache->mutex);
+        cache->shapes.insert(key, new ShapeCacheEntry { path, rectangles });
+    }
+
+    return rectangles;
+}
+
 static void setShapeRectangles(quint32 WId, const QVector<xcb_rectangle_t> &rectangles, bool onlyInput, bool transparentInput = false)
 {
     xcb_shape_mask(QX11Info::connection(), XCB_SHAPE_SO_SET,
@@ -292,23 +932,7 @@ void Utility::setShapePath(quint32 WId, const QPainterPath &path, bool onlyInput
         return ::setShapeRectangles(WId, QVector<xcb_rectangle_t>(), onlyInput, transparentInput);
     }
 
-    QVector<xcb_rectangle_t> rectangles;
-
-    foreach(const QPolygonF &polygon, path.toFillPolygons()) {
-        QRegion region(polygon.toPolygon());
-        for (auto area = region.cbegin(); area != region.cend(); ++area) {
-            xcb_rectangle_t rectangle;
-
-            rectangle.x = area->x();
-            rectangle.y = area->y();
-            rectangle.width = area->width();
-            rectangle.height = area->height();
-
-            rectangles.append(std::move(rectangle));
-        }
-    }
-
-    ::setShapeRectangles(WId, rectangles, onlyInput, transparentInput);
+    ::setShapeRectangles(WId, shapePathRectangles(path), onlyInput, transparentInput);
 }
 
 void Utility::sendMoveResizeMessage(quint32 WId, uint32_t action, QPoint globalPos, Qt::MouseButton qbutton)
@@ -424,7 +1048,7 @@ QByteArray Utility::windowProperty(quint32 WId, xcb_atom_t propAtom, xcb_atom_t
     xcb_connection_t* conn = QX11Info::connection();
     xcb_get_property_cookie_t cookie = xcb_get_property(conn, false, WId, propAtom, typeAtom, 0, len);
     xcb_generic_error_t* err = nullptr;
-    xcb_get_property_reply_t* reply = xcb_get_property_reply(conn, cookie, &err);
+    xcb_get_property_reply_t* reply = D_XCB_ROUNDTRIP(xcb_get_property_reply(conn, cookie, &err));
 
     if (reply != nullptr) {
         len = xcb_get_property_value_length(reply);
@@ -506,6 +1130,169 @@ bool Utility::supportForSplittingWindowByType(quint32 WId, quint32 screenSplitti
     return false;
 }
 
+namespace {
+struct BlurPropertyCache {
+    QMutex mutex;
+    // 每个窗口最后一次写入的模糊区域属性，内容相同时不再重复发送
+    // 蒙版数据可能有数MB，按实际字节数计算开销
+    QCache<quint32, QByteArray> masks { 8 * 1024 * 1024 };
+    QCache<quint32, QVector<quint32>> regions { 1024 * 1024 };
+    // 以 (宽, 高, x半径, y半径) 为键缓存圆角矩形对应的矩形列表
+    QCache<quint64, QVector<xcb_rectangle_t>> roundedRects { 32 };
+};
+}
+
+Q_GLOBAL_STATIC(BlurPropertyCache, blurPropertyCache)
+
+static inline int blurPropertyCost(const QByteArray &data)
+{
+    return qMax(int(data.size()), 1);
+}
+
+static inline int blurPropertyCost(const QVector<quint32> &rects)
+{
+    return qMax(int(rects.size() * sizeof(quint32)), 1);
+}
+
+// 返回 false 表示此窗口上次写入的内容与 data 完全相同
+template<typename T>
+static bool updateLastBlurProperty(QCache<quint32, T> BlurPropertyCache::*member, quint32 WId, const T &data)
+{
+    BlurPropertyCache *cache = blurPropertyCache;
+
+    if (!cache)
+        return true;
+
+    QMutexLocker locker(&cache->mutex);
+    QCache<quint32, T> &last_data = cache->*member;
+    const T *last = last_data.object(WId);
+
+    if (last && *last == data)
+        return false;
+
+    // 超出总开销的数据不会被缓存，下次依然会写入
+    last_data.insert(WId, new T(data), blurPropertyCost(data));
+
+    return true;
+}
+
+static bool updateBlurMaskCache(quint32 WId, const QByteArray &data)
+{
+    return updateLastBlurProperty(&BlurPropertyCache::masks, WId, data);
+}
+
+static bool updateBlurRegionCache(quint32 WId, const QVector<quint32> &rects)
+{
+    return updateLastBlurProperty(&BlurPropertyCache::regions, WId, rects);
+}
+
+static void invalidateBlurMaskCache(quint32 WId)
+{
+    BlurPropertyCache *cache = blurPropertyCache;
+
+    if (!cache)
+        return;
+
+    QMutexLocker locker(&cache->mutex);
+    cache->masks.remove(WId);
+}
+
+static void invalidateBlurRegionCache(quint32 WId)
+{
+    BlurPropertyCache *cache = blurPropertyCache;
+
+    if (!cache)
+        return;
+
+    QMutexLocker locker(&cache->mutex);
+    cache->regions.remove(WId);
+}
+
+// 将圆角区域转换为矩形列表追加到 rects 中，不再经过 QPainterPath 和 QRegion
+static void appendRoundedBlurArea(QVector<quint32> &rects, const Utility::BlurArea &area)
+{
+    QVector<xcb_rectangle_t> rectangles;
+    BlurPropertyCache *cache = blurPropertyCache;
+    const bool cacheable = cache && quint32(area.width | area.height | area.xRadius | area.yRaduis) <= 0xffff;
+    const quint64 key = (quint64(area.width) << 48) | (quint64(area.height) << 32)
+            | (quint64(area.xRadius) << 16) | quint64(area.yRaduis);
+
+    if (cacheable) {
+        QMutexLocker locker(&cache->mutex);
+
+        if (const QVector<xcb_rectangle_t> *cached = cache->roundedRects.object(key))
+            rectangles = *cached;
+    }
+
+    if (rectangles.isEmpty()) {
+        // 与 QPainterPath::addRoundedRect 相同，半径不能超过边长的一半
+        const qreal x_radius = qMin(qreal(area.xRadius), area.width / 2.0);
+        const qreal y_radius = qMin(qreal(area.yRaduis), area.height / 2.0);
+
+        rectangles = roundedRectShapeRectangles(QRectF(0, 0, area.width, area.height), x_radius, y_radius);
+
+        if (cacheable) {
+            QMutexLocker locker(&cache->mutex);
+            cache->roundedRects.insert(key, new QVector<xcb_rectangle_t>(rectangles));
+        }
+    }
+
+    rects.reserve(rects.size() + rectangles.size() * 4);
+
+    for (int i = 0; i < rectangles.size(); ++i) {
+        const xcb_rectangle_t &r = rectangles.at(i);
+        rects << area.x + r.x << area.y + r.y << r.width << r.height;
+    }
+}
+
+/*!
+ * \brief 将 Alpha8 格式的蒙版按行进行游程编码
+ * 每行由若干 (长度, alpha) 字节对组成，长度为 1~255，一行中所有长度之和等于蒙版宽度；
+ * 字节对 (0, n) 表示将上一行重复 n 次(n 为 1~255)。
+ */
+static void appendBlurMaskRle(QByteArray &data, const QImage &maskImage)
+{
+    const int width = maskImage.width();
+    const uchar *last_line = nullptr;
+    int repeat = 0;
+
+    auto flushRepeat = [&] {
+        while (repeat > 0) {
+            const int count = qMin(repeat, 255);
+
+            data.append(char(0));
+            data.append(char(count));
+            repeat -= count;
+        }
+    };
+
+    for (int y = 0; y < maskImage.height(); ++y) {
+        const uchar *line = maskImage.constScanLine(y);
+
+        if (last_line && memcmp(line, last_line, width) == 0) {
+            ++repeat;
+            continue;
+        }
+
+        flushRepeat();
+        last_line = line;
+
+        for (int x = 0; x < width;) {
+            const uchar alpha = line[x];
+            int length = 1;
+
+            while (x + length < width && length < 255 && line[x + length] == alpha)
+                ++length;
+
+            data.append(char(length));
+            data.append(char(alpha));
+            x += length;
+        }
+    }
+
+    flushRepeat();
+}
+
 bool Utility::setEnableBlurWindow(const quint32 WId, bool enable)
 {
     if (!DXcbWMSupport::instance()->hasBlurWindow() || !DXcbWMSupport::instance()->isKwin())
@@ -517,6 +1304,8 @@ bool Utility::setEnableBlurWindow(const quint32 WId, bool enable)
         return false;
 
     clearWindowProperty(WId, DXcbWMSupport::instance()->_net_wm_deepin_blur_region_mask);
+    invalidateBlurMaskCache(WId);
+    invalidateBlurRegionCache(WId);
 
     if (enable) {
         quint32 value = enable;
@@ -546,6 +1335,7 @@ bool Utility::blurWindowBackground(const quint32 WId, const QVector<BlurArea> &a
         }
 
         clearWindowProperty(WId, DXcbWMSupport::instance()->_net_wm_deepin_blur_region_mask);
+        invalidateBlurMaskCache(WId);
         setWindowProperty(WId, atom, XCB_ATOM_CARDINAL, areas.constData(), areas.size() * sizeof(BlurArea) / sizeof(quint32), sizeof(quint32) * 8);
     } else {
         xcb_atom_t atom = DXcbWMSupport::instance()->_kde_net_wm_blur_rehind_region_atom;
@@ -559,22 +1349,14 @@ bool Utility::blurWindowBackground(const quint32 WId, const QVector<BlurArea> &a
             if (area.xRadius <= 0 || area.yRaduis <= 0) {
                 rects << area.x << area.y << area.width << area.height;
             } else {
-                QPainterPath path;
-
-                path.addRoundedRect(area.x, area.y, area.width, area.height, area.xRadius, area.yRaduis);
-
-                foreach(const QPolygonF &polygon, path.toFillPolygons()) {
-                    QRegion region(polygon.toPolygon());
-                    for(auto area = region.cbegin(); area != region.cend(); ++area) {
-                        rects << area->x() << area->y() << area->width() << area->height();
-                    }
-                }
+                appendRoundedBlurArea(rects, area);
             }
         }
 
         clearWindowProperty(WId, DXcbWMSupport::instance()->_net_wm_deepin_blur_region_mask);
+        invalidateBlurMaskCache(WId);
 
-        if (!areas.isEmpty())
+        if (!areas.isEmpty() && updateBlurRegionCache(WId, rects))
             setWindowProperty(WId, atom, XCB_ATOM_CARDINAL, rects.constData(), rects.size(), sizeof(quint32) * 8);
     }
 
@@ -612,20 +1394,23 @@ bool Utility::blurWindowBackgroundByPaths(const quint32 WId, const QList<QPainte
 
         if (paths.isEmpty()) {
             clearWindowProperty(WId, DXcbWMSupport::instance()->_net_wm_deepin_blur_region_mask);
+            invalidateBlurMaskCache(WId);
             return true;
         }
 
         QVector<quint32> rects;
 
         foreach (const QPainterPath &path, paths) {
-            foreach(const QPolygonF &polygon, path.toFillPolygons()) {
-                QRegion region(polygon.toPolygon());
-                for(auto area = region.cbegin(); area != region.cend(); ++area) {
-                    rects << area->x() << area->y() << area->width() << area->height();
-                }
-            }
+            // 与窗口形状共用同一份缓存，圆角矩形路径不会被逐多边形光栅化
+            const QVector<xcb_rectangle_t> rectangles = shapePathRectangles(path);
+
+            for (const xcb_rectangle_t &r : rectangles)
+                rects << r.x << r.y << r.width << r.height;
         }
 
+        if (!updateBlurRegionCache(WId, rects))
+            return true;
+
         setWindowProperty(WId, atom, XCB_ATOM_CARDINAL, rects.constData(), rects.size(), sizeof(quint32) * 8);
     }
 
@@ -639,16 +1424,36 @@ bool Utility::blurWindowBackgroundByImage(const quint32 WId, const QRect &blurRe
 
     QByteArray array;
     QVector<qint32> area;
+    // 窗口管理器支持时使用游程编码的蒙版，避免每次传输整张图片
+    const xcb_atom_t rle_atom = DXcbWMSupport::instance()->_net_wm_deepin_blur_region_mask_rle;
+    const bool use_rle = rle_atom != XCB_NONE && DXcbWMSupport::instance()->isSupportedByWM(rle_atom);
+
+    if (use_rle) {
+        area.reserve(6);
+        area << blurRect.x() << blurRect.y() << blurRect.width() << blurRect.height()
+             << maskImage.width() << maskImage.height();
+        array.append((const char*)area.constData(), sizeof(qint32) / sizeof(char) * area.size());
+        appendBlurMaskRle(array, maskImage);
+    } else {
+        area.reserve(5);
+        area << blurRect.x() << blurRect.y() << blurRect.width() << blurRect.height() << maskImage.bytesPerLine();
+        array.reserve(area.size() * sizeof(qint32) / sizeof(char) * area.size() + maskImage.sizeInBytes());
+        array.append((const char*)area.constData(), sizeof(qint32) / sizeof(char) * area.size());
+        array.append((const char*)maskImage.constBits(), maskImage.sizeInBytes());
+    }
+
+    // 两种编码的属性类型不同，缓存的内容中也要区分
+    array.append(char(use_rle));
+
+    if (!updateBlurMaskCache(WId, array))
+        return true;
 
-    area.reserve(5);
-    area << blurRect.x() << blurRect.y() << blurRect.width() << blurRect.height() << maskImage.bytesPerLine();
-    array.reserve(area.size() * sizeof(qint32) / sizeof(char) * area.size() + maskImage.sizeInBytes());
-    array.append((const char*)area.constData(), sizeof(qint32) / sizeof(char) * area.size());
-    array.append((const char*)maskImage.constBits(), maskImage.sizeInBytes());
+    array.chop(1);
+
+    const xcb_atom_t mask_atom = DXcbWMSupport::instance()->_net_wm_deepin_blur_region_mask;
 
     clearWindowProperty(WId, DXcbWMSupport::instance()->_net_wm_deepin_blur_region_rounded_atom);
-    setWindowProperty(WId, DXcbWMSupport::instance()->_net_wm_deepin_blur_region_mask,
-                      DXcbWMSupport::instance()->_net_wm_deepin_blur_region_mask,
+    setWindowProperty(WId, mask_atom, use_rle ? rle_atom : mask_atom,
                       array.constData(), array.length(), 8);
 
     return true;
@@ -676,6 +1481,14 @@ void Utility::clearWindowBlur(const quint32 WId)
     clearWindowProperty(WId, DXcbWMSupport::instance()->_net_wm_deepin_blur_region_rounded_atom);
     clearWindowProperty(WId, DXcbWMSupport::instance()->_net_wm_deepin_blur_region_mask);
     clearWindowProperty(WId, DXcbWMSupport::instance()->_kde_net_wm_blur_rehind_region_atom);
+    invalidateBlurMaskCache(WId);
+    invalidateBlurRegionCache(WId);
+}
+
+void Utility::removeWindowBlurCache(const quint32 WId)
+{
+    invalidateBlurMaskCache(WId);
+    invalidateBlurRegionCache(WId);
 }
 
 void Utility::clearWindowBackground(const quint32 WId)
@@ -688,7 +1501,7 @@ qint32 Utility::getWorkspaceForWindow(quint32 WId)
     xcb_get_property_cookie_t cookie = xcb_get_property(DPlatformIntegration::xcbConnection()->xcb_connection(), false, WId,
                                                         Utility::internAtom("_NET_WM_DESKTOP"), XCB_ATOM_CARDINAL, 0, 1);
     QScopedPointer<xcb_get_property_reply_t, QScopedPointerPodDeleter> reply(
-        xcb_get_property_reply(DPlatformIntegration::xcbConnection()->xcb_connection(), cookie, NULL));
+        D_XCB_ROUNDTRIP(xcb_get_property_reply(DPlatformIntegration::xcbConnection()->xcb_connection(), cookie, NULL)));
     if (reply && reply->type == XCB_ATOM_CARDINAL && reply->format == 32 && reply->value_len == 1) {
         return *(qint32*)xcb_get_property_value(reply.data());
     }
@@ -696,20 +1509,21 @@ qint32 Utility::getWorkspaceForWindow(quint32 WId)
     return 0;
 }
 
-Utility::QtMotifWmHints Utility::getMotifWmHints(quint32 WId)
+static xcb_get_property_cookie_t motifWmHintsCookie(xcb_connection_t *xcb_connect, quint32 WId)
 {
-    xcb_connection_t *xcb_connect = DPlatformIntegration::xcbConnection()->xcb_connection();
-    QtMotifWmHints hints;
+    return xcb_get_property_unchecked(xcb_connect, 0, WId, DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_MOTIF_WM_HINTS)),
+                                      DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_MOTIF_WM_HINTS)), 0, 20);
+}
 
-    xcb_get_property_cookie_t get_cookie =
-        xcb_get_property_unchecked(xcb_connect, 0, WId, DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_MOTIF_WM_HINTS)),
-                                   DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_MOTIF_WM_HINTS)), 0, 20);
+static Utility::QtMotifWmHints motifWmHintsFromCookie(xcb_connection_t *xcb_connect, xcb_get_property_cookie_t cookie)
+{
+    Utility::QtMotifWmHints hints;
 
     xcb_get_property_reply_t *reply =
-        xcb_get_property_reply(xcb_connect, get_cookie, NULL);
+        D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connect, cookie, NULL));
 
     if (reply && reply->format == 32 && reply->type == DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_MOTIF_WM_HINTS))) {
-        hints = *((QtMotifWmHints *)xcb_get_property_value(reply));
+        hints = *((Utility::QtMotifWmHints *)xcb_get_property_value(reply));
     } else {
         hints.flags = 0L;
         hints.functions = DXcbWMSupport::MWM_FUNC_ALL;
@@ -723,6 +1537,13 @@ Utility::QtMotifWmHints Utility::getMotifWmHints(quint32 WId)
     return hints;
 }
 
+Utility::QtMotifWmHints Utility::getMotifWmHints(quint32 WId)
+{
+    xcb_connection_t *xcb_connect = DPlatformIntegration::xcbConnection()->xcb_connection();
+
+    return motifWmHintsFromCookie(xcb_connect, motifWmHintsCookie(xcb_connect, WId));
+}
+
 void Utility::setMotifWmHints(quint32 WId, Utility::QtMotifWmHints hints)
 {
     if (hints.flags != 0l) {
@@ -767,37 +1588,90 @@ void Utility::setMotifWmHints(quint32 WId, Utility::QtMotifWmHints hints)
     }
 }
 
+typedef QHash<quint32, quint32> TopLevelWindowCache;
+Q_GLOBAL_STATIC(TopLevelWindowCache, topLevelWindowCache)
+
+// 窗口id的高位是X server分配给每个客户端的资源id基址，据此无需请求X server即可判断窗口是否由此连接创建
+static bool isOwnWindow(xcb_connection_t *connection, quint32 WId)
+{
+    const xcb_setup_t *setup = xcb_get_setup(connection);
+    return setup && (WId & ~setup->resource_id_mask) == setup->resource_id_base;
+}
+
 quint32 Utility::getNativeTopLevelWindow(quint32 WId)
 {
+    auto cached = topLevelWindowCache->constFind(WId);
+
+    if (cached != topLevelWindowCache->constEnd())
+        return cached.value();
+
+    const quint32 window = WId;
     xcb_connection_t *xcb_connection = DPlatformIntegration::xcbConnection()->xcb_connection();
 
-    do {
-        xcb_query_tree_cookie_t cookie = xcb_query_tree_unchecked(xcb_connection, WId);
-        QScopedPointer<xcb_query_tree_reply_t, QScopedPointerPodDeleter> reply(xcb_query_tree_reply(xcb_connection, cookie, NULL));
+    // 每一层的 query_tree 与父窗口的 motif hints 请求一起发出后再等待回复，
+    // 父窗口的 hints 在下一层中即为当前窗口的 hints，无需再次请求
+    xcb_query_tree_cookie_t tree_cookie = xcb_query_tree_unchecked(xcb_connection, WId);
+    xcb_get_property_cookie_t hints_cookie = motifWmHintsCookie(xcb_connection, WId);
+    bool has_hints_cookie = true;
+    QtMotifWmHints hints;
+    // 只有此连接创建的窗口才会收到销毁、重新设置父窗口等事件，查找路径上有其它客户端的窗口时不能缓存结果，
+    // 否则它们的变化无法使缓存失效
+    bool cacheable = isOwnWindow(xcb_connection, WId);
 
-        if (reply) {
-            if (reply->parent == reply->root)
-                break;
+    do {
+        QScopedPointer<xcb_query_tree_reply_t, QScopedPointerPodDeleter> reply(D_XCB_ROUNDTRIP(xcb_query_tree_reply(xcb_connection, tree_cookie, NULL)));
 
-            QtMotifWmHints hints = getMotifWmHints(reply->parent);
+        if (!reply || reply->parent == reply->root)
+            break;
 
-            if (hints.flags == 0)
-                break;
+        xcb_query_tree_cookie_t parent_tree_cookie = xcb_query_tree_unchecked(xcb_connection, reply->parent);
+        QtMotifWmHints parent_hints = motifWmHintsFromCookie(xcb_connection, motifWmHintsCookie(xcb_connection, reply->parent));
 
-            hints = getMotifWmHints(WId);
+        if (parent_hints.flags == 0) {
+            xcb_discard_reply(xcb_connection, parent_tree_cookie.sequence);
+            break;
+        }
 
-            if ((hints.decorations & DXcbWMSupport::MWM_DECOR_BORDER) == DXcbWMSupport::MWM_DECOR_BORDER)
-                break;
+        if (has_hints_cookie) {
+            hints = motifWmHintsFromCookie(xcb_connection, hints_cookie);
+            has_hints_cookie = false;
+        }
 
-            WId = reply->parent;
-        } else {
+        if ((hints.decorations & DXcbWMSupport::MWM_DECOR_BORDER) == DXcbWMSupport::MWM_DECOR_BORDER) {
+            xcb_discard_reply(xcb_connection, parent_tree_cookie.sequence);
             break;
         }
+
+        WId = reply->parent;
+        tree_cookie = parent_tree_cookie;
+        hints = parent_hints;
+        cacheable = cacheable && isOwnWindow(xcb_connection, WId);
     } while (true);
 
+    if (has_hints_cookie)
+        xcb_discard_reply(xcb_connection, hints_cookie.sequence);
+
+    if (cacheable)
+        topLevelWindowCache->insert(window, WId);
+
     return WId;
 }
 
+void Utility::invalidateNativeTopLevelWindow(quint32 WId)
+{
+    for (auto it = topLevelWindowCache->begin(); it != topLevelWindowCache->end();) {
+        if (it.key() == WId || it.value() == WId)
+            it = topLevelWindowCache->erase(it);
+        else
+            ++it;
+    }
+}
+
+void Utility::clearNativeTopLevelWindowCache()
+{
+    topLevelWindowCache->clear();
+}
+
 QPoint Utility::translateCoordinates(const QPoint &pos, quint32 src, quint32 dst)
 {
     QPoint ret;
@@ -805,7 +1679,7 @@ QPoint Utility::translateCoordinates(const QPoint &pos, quint32 src, quint32 dst
         xcb_translate_coordinates(DPlatformIntegration::xcbConnection()->xcb_connection(), src, dst,
                                   pos.x(), pos.y());
     xcb_translate_coordinates_reply_t *reply =
-        xcb_translate_coordinates_reply(DPlatformIntegration::xcbConnection()->xcb_connection(), cookie, NULL);
+        D_XCB_ROUNDTRIP(xcb_translate_coordinates_reply(DPlatformIntegration::xcbConnection()->xcb_connection(), cookie, NULL));
     if (reply) {
         ret.setX(reply->dst_x);
         ret.setY(reply->dst_y);
@@ -818,10 +1692,10 @@ QPoint Utility::translateCoordinates(const QPoint &pos, quint32 src, quint32 dst
 QRect Utility::windowGeometry(quint32 WId)
 {
     xcb_get_geometry_reply_t *geom =
-        xcb_get_geometry_reply(
+        D_XCB_ROUNDTRIP(xcb_get_geometry_reply(
             DPlatformIntegration::xcbConnection()->xcb_connection(),
             xcb_get_geometry(DPlatformIntegration::xcbConnection()->xcb_connection(), WId),
-            NULL);
+            NULL));
 
     QRect rect;
 
@@ -916,7 +1790,7 @@ void Utility::setWindowGroup(quint32 window, quint32 groupLeader)
 
     xcb_get_property_cookie_t cookie = xcb_icccm_get_wm_hints_unchecked(connection->xcb_connection(), window);
     xcb_icccm_wm_hints_t hints;
-    xcb_icccm_get_wm_hints_reply(connection->xcb_connection(), cookie, &hints, NULL);
+    D_XCB_ROUNDTRIP(xcb_icccm_get_wm_hints_reply(connection->xcb_connection(), cookie, &hints, NULL));
 
     if (groupLeader > 0) {
         xcb_icccm_wm_hints_set_window_group(&hints, groupLeader);
@@ -950,7 +1824,7 @@ QVector<uint> Utility::getCurrentWorkspaceWindows()
                                                         DPlatformIntegration::xcbConnection()->rootWindow(),
                                                         Utility::internAtom("_NET_CURRENT_DESKTOP"), XCB_ATOM_CARDINAL, 0, 1);
     QScopedPointer<xcb_get_property_reply_t, QScopedPointerPodDeleter> reply(
-        xcb_get_property_reply(DPlatformIntegration::xcbConnection()->xcb_connection(), cookie, NULL));
+        D_XCB_ROUNDTRIP(xcb_get_property_reply(DPlatformIntegration::xcbConnection()->xcb_connection(), cookie, NULL)));
     if (reply && reply->type == XCB_ATOM_CARDINAL && reply->format == 32 && reply->value_len == 1) {
         current_workspace = *(qint32*)xcb_get_property_value(reply.data());
     }
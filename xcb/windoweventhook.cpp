@@ -17,6 +17,7 @@ QT_END_NAMESPACE
 #include "utility.h"
 #include "dframewindow.h"
 #include "dplatformwindowhelper.h"
+#include "dxcbroundtrip.h"
 #include "dhighdpi.h"
 
 #define private public
@@ -114,19 +115,19 @@ xcb_atom_t toXdndAction(const QXcbDrag *drag, Qt::DropAction a)
 
 void WindowEventHook::handleConfigureNotifyEvent(QXcbWindow *window, const xcb_configure_notify_event_t *event)
 {
-    DPlatformWindowHelper *helper = DPlatformWindowHelper::mapped.value(window);
+    DFrameWindow *frame = DFrameWindow::findByClientWinId(event->window);
 
-    if (helper) {
-        QWindowPrivate::get(window->window())->parentWindow = helper->m_frameWindow;
+    if (frame) {
+        QWindowPrivate::get(window->window())->parentWindow = frame;
     }
 
     window->QXcbWindow::handleConfigureNotifyEvent(event);
 
-    if (helper) {
+    if (frame) {
         QWindowPrivate::get(window->window())->parentWindow = nullptr;
 
-        if (helper->m_frameWindow->redirectContent())
-            helper->m_frameWindow->markXPixmapToDirty(event->width, event->height);
+        if (frame->redirectContent())
+            frame->markXPixmapToDirty(event->width, event->height);
     }
 }
 
@@ -181,7 +182,7 @@ void WindowEventHook::handleClientMessageEvent(QXcbWindow *window, const xcb_cli
             xcb_get_property_cookie_t cookie = xcb_get_property(xcb_connection, false, drag->xdnd_dragsource,
                                                                 window->connection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(XdndActionList)),
                                                                 XCB_ATOM_ATOM, offset, 1024);
-            xcb_get_property_reply_t *reply = xcb_get_property_reply(xcb_connection, cookie, NULL);
+            xcb_get_property_reply_t *reply = D_XCB_ROUNDTRIP(xcb_get_property_reply(xcb_connection, cookie, NULL));
             if (!reply)
                 break;
 
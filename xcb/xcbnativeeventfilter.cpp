@@ -33,7 +33,6 @@ DPP_BEGIN_NAMESPACE
 
 XcbNativeEventFilter::XcbNativeEventFilter(QXcbConnection *connection)
     : m_connection(connection)
-    , lastXIEventDeviceInfo(0, XIDeviceInfos())
 {
     // init damage first event value
     xcb_prefetch_extension_data(connection->xcb_connection(), &xcb_damage_id);
@@ -46,7 +45,68 @@ XcbNativeEventFilter::XcbNativeEventFilter(QXcbConnection *connection)
         m_damageFirstEvent = 0;
     }
 
-    updateXIDeviceInfoMap();
+    initPropertyActions();
+
+    // 用于区分触摸板和鼠标的设备属性
+    xiTouchpadPropertyAtoms[0] = Utility::internAtom(connection->xcb_connection(), "Synaptics Off", false);
+    xiTouchpadPropertyAtoms[1] = Utility::internAtom(connection->xcb_connection(), "libinput Tapping Enabled", false);
+    xiMousePropertyAtoms[0] = Utility::internAtom(connection->xcb_connection(), "Button Labels", false);
+    xiMousePropertyAtoms[1] = Utility::internAtom(connection->xcb_connection(), "libinput Button Scrolling Button", false);
+}
+
+void XcbNativeEventFilter::initPropertyActions()
+{
+    // 预先申请所有需要处理的atom，避免处理事件时再同步申请。
+    // 申请时不使用 only_if_exists，保证窗口管理器之后才创建这些atom时仍能匹配
+    m_propertyActions.insert(m_connection->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_MOTIF_WM_HINTS)), MotifWmHintsChanged);
+    m_propertyActions.insert(Utility::internAtom(m_connection->xcb_connection(), "_DEEPIN_WALLPAPER_SHARED_MEMORY", false), WallpaperSharedChanged);
+    m_propertyActions.insert(m_connection->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_NET_SUPPORTED)), NetSupportedChanged);
+    m_propertyActions.insert(m_connection->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_NET_SUPPORTING_WM_CHECK)), SupportingWmCheckChanged);
+    m_propertyActions.insert(Utility::internAtom(m_connection->xcb_connection(), "_KDE_NET_WM_BLUR_BEHIND_REGION", false), BlurBehindRegionChanged);
+    m_propertyActions.insert(Utility::internAtom(m_connection->xcb_connection(), "_NET_CLIENT_LIST_STACKING", false), ClientListStackingChanged);
+    m_propertyActions.insert(Utility::internAtom(m_connection->xcb_connection(), "_NET_KDE_COMPOSITE_TOGGLING", false), CompositeTogglingChanged);
+    m_propertyActions.remove(XCB_NONE);
+}
+
+void XcbNativeEventFilter::handlePropertyNotifyEvent(const xcb_property_notify_event_t *event)
+{
+    // xsettings 的属性在其选择所有者窗口上，由 DXcbXSettings 自行判断
+    if (DXcbXSettings::handlePropertyNotifyEvent(event))
+        return;
+
+    // 窗口管理器会频繁更新 _NET_ACTIVE_WINDOW 等根窗口属性，不关心的属性直接忽略
+    auto action = m_propertyActions.constFind(event->atom);
+
+    if (action == m_propertyActions.constEnd())
+        return;
+
+    if (action.value() >= RootWindowOnly && event->window != CONNECTION->rootWindow())
+        return;
+
+    switch (action.value()) {
+    case MotifWmHintsChanged:
+        // 顶层窗口的查找依赖motif hints
+        Utility::clearNativeTopLevelWindowCache();
+        DXcbWMSupport::instance()->updateMotifWmHints(event->window);
+        emit DXcbWMSupport::instance()->windowMotifWMHintsChanged(event->window);
+        break;
+    case WallpaperSharedChanged:
+        DXcbWMSupport::instance()->wallpaperSharedChanged();
+        break;
+    case NetSupportedChanged:
+        DXcbWMSupport::instance()->updateNetWMAtoms();
+        break;
+    case SupportingWmCheckChanged:
+    case CompositeTogglingChanged:
+        DXcbWMSupport::instance()->updateWMName();
+        break;
+    case BlurBehindRegionChanged:
+        DXcbWMSupport::instance()->updateRootWindowProperties();
+        break;
+    case ClientListStackingChanged:
+        emit DXcbWMSupport::instance()->windowListChanged();
+        break;
+    }
 }
 
 QClipboard::Mode XcbNativeEventFilter::clipboardModeForAtom(xcb_atom_t a) const
@@ -109,45 +169,13 @@ bool XcbNativeEventFilter::nativeEventFilter(const QByteArray &eventType, void *
     } else if (Q_UNLIKELY(response_type == m_damageFirstEvent + XCB_DAMAGE_NOTIFY)) {
         xcb_damage_notify_event_t *ev = (xcb_damage_notify_event_t*)event;
 
-        QXcbWindow *window = m_connection->platformWindowFromId(ev->drawable);
-
-        if (Q_LIKELY(window)) {
-            DPlatformWindowHelper *helper = DPlatformWindowHelper::mapped.value(window);
-
-            if (Q_LIKELY(helper)) {
-                helper->m_frameWindow->updateFromContents(ev);
-            }
-        }
+        if (DFrameWindow *frame = DFrameWindow::findByClientWinId(ev->drawable))
+            frame->updateFromContents(ev);
     } else {
         switch (response_type) {
-        case XCB_PROPERTY_NOTIFY: {
-            xcb_property_notify_event_t *pn = (xcb_property_notify_event_t *)event;
-
-            DXcbXSettings::handlePropertyNotifyEvent(pn);
-
-            if (pn->atom == DPlatformIntegration::xcbConnection()->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_MOTIF_WM_HINTS))) {
-                emit DXcbWMSupport::instance()->windowMotifWMHintsChanged(pn->window);
-            } else if (pn->atom == DXcbWMSupport::instance()->_deepin_wallpaper_shared_key) {
-                    DXcbWMSupport::instance()->wallpaperSharedChanged();
-            } else {
-                if (pn->window != CONNECTION->rootWindow()) {
-                    return false;
-                }
-
-                if (pn->atom == CONNECTION->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_NET_SUPPORTED))) {
-                    DXcbWMSupport::instance()->updateNetWMAtoms();
-                } else if (pn->atom == CONNECTION->atom(QXcbAtom::D_QXCBATOM_WRAPPER(_NET_SUPPORTING_WM_CHECK))) {
-                    DXcbWMSupport::instance()->updateWMName();
-                } else if (pn->atom == DXcbWMSupport::instance()->_kde_net_wm_blur_rehind_region_atom) {
-                    DXcbWMSupport::instance()->updateRootWindowProperties();
-                } else if (pn->atom == Utility::internAtom("_NET_CLIENT_LIST_STACKING")) {
-                    emit DXcbWMSupport::instance()->windowListChanged();
-                } else if (pn->atom == Utility::internAtom("_NET_KDE_COMPOSITE_TOGGLING")) {
-                    DXcbWMSupport::instance()->updateWMName();
-                }
-            }
+        case XCB_PROPERTY_NOTIFY:
+            handlePropertyNotifyEvent(reinterpret_cast<xcb_property_notify_event_t*>(event));
             break;
-        }
             // 修复Qt程序对触摸板的自然滚动开关后不能实时生效
             // 由于在收到xi的DeviceChanged事件后，Qt更新ScrollingDevice时没有更新verticalIncrement字段
             // 导致那些使用increment的正负值控制自然滚动开关的设备对Qt程序无法实时生效
@@ -169,22 +197,33 @@ bool XcbNativeEventFilter::nativeEventFilter(const QByteArray &eventType, void *
                     // and allow casting, overwriting the full_sequence field.
                     uint16_t source_id = *(&xiDEvent->sourceid + 2);
 
-                    auto device = xiDeviceInfoMap.find(source_id);
-
-                    // find device
-                    if (Q_LIKELY(device != xiDeviceInfoMap.constEnd())) {
-                        lastXIEventDeviceInfo = qMakePair(xiDEvent->time, device.value());
+                    // 只有这些事件的结构是 xXIDeviceEvent，其它事件中没有有效的 sourceid
+                    if ((xiEvent->evtype >= XI_KeyPress && xiEvent->evtype <= XI_Motion)
+                            || (xiEvent->evtype >= XI_TouchBegin && xiEvent->evtype <= XI_TouchEnd)) {
+                        XIEventSource &source = xiEventSources[xiDEvent->time % XIEventSourceCount];
+                        const DeviceType type = xiDeviceInfo(source_id).type;
+
+                        if (source.time != xiDEvent->time) {
+                            source.time = xiDEvent->time;
+                            source.type = type;
+                        } else if (source.type != type) {
+                            // 同一毫秒内来自不同类型设备的事件无法通过时间戳区分，宁可返回未知设备也不要返回错误的类型
+                            source.type = UnknowDevice;
+                        }
                     }
                 }
 
+                // 窗口管理器处理的交互式缩放在鼠标(触摸点)释放或抓取结束时结束
+                // xXIEnterEvent 的 mode 字段位于前32个字节内，不受 full_sequence 字段的影响
+                if (xiEvent->evtype == XI_ButtonRelease || xiEvent->evtype == XI_TouchEnd
+                        || ((xiEvent->evtype == XI_Enter || xiEvent->evtype == XI_Leave)
+                            && reinterpret_cast<xXIEnterEvent*>(event)->mode == XINotifyUngrab)) {
+                    DPlatformWindowHelper::endAllInteractiveResize();
+                }
+
                 if (Q_LIKELY(xiEvent->evtype != XI_DeviceChanged)) {
                     if (Q_UNLIKELY(xiEvent->evtype == XI_HierarchyChanged)) {
-                        xXIHierarchyEvent *xiEvent = reinterpret_cast<xXIHierarchyEvent *>(event);
-                        // We only care about hotplugged devices
-                        if (!(xiEvent->flags & (XISlaveRemoved | XISlaveAdded)))
-                            return false;
-
-                        updateXIDeviceInfoMap();
+                        handleXIHierarchyEvent(event);
                     }
 
                     return false;
@@ -231,6 +270,30 @@ bool XcbNativeEventFilter::nativeEventFilter(const QByteArray &eventType, void *
             break;
         }
 #endif
+        case XCB_BUTTON_RELEASE:
+            DPlatformWindowHelper::endAllInteractiveResize();
+            break;
+        case XCB_ENTER_NOTIFY:
+        case XCB_LEAVE_NOTIFY: {
+            xcb_enter_notify_event_t *ev = reinterpret_cast<xcb_enter_notify_event_t*>(event);
+
+            if (ev->mode == XCB_NOTIFY_MODE_UNGRAB)
+                DPlatformWindowHelper::endAllInteractiveResize();
+            break;
+        }
+        case XCB_REPARENT_NOTIFY: {
+            // 窗口树发生变化，之前查找到的顶层窗口都可能已失效
+            Utility::clearNativeTopLevelWindowCache();
+            break;
+        }
+        case XCB_DESTROY_NOTIFY: {
+            xcb_destroy_notify_event_t *ev = reinterpret_cast<xcb_destroy_notify_event_t*>(event);
+
+            Utility::invalidateNativeTopLevelWindow(ev->window);
+            Utility::removeWindowBlurCache(ev->window);
+            DXcbWMSupport::instance()->removeMotifWmHints(ev->window);
+            break;
+        }
         case XCB_CLIENT_MESSAGE: {
             xcb_client_message_event_t *ev = reinterpret_cast<xcb_client_message_event_t*>(event);
 
@@ -275,16 +338,31 @@ bool XcbNativeEventFilter::nativeEventFilter(const QByteArray &eventType, void *
 
 DeviceType XcbNativeEventFilter::xiEventSource(const QInputEvent *event) const
 {
-    if (lastXIEventDeviceInfo.first == event->timestamp())
-        return lastXIEventDeviceInfo.second.type;
+    // 交错到达的事件时间戳不同，会落在不同的位置，不会互相覆盖；时间戳相同时见 nativeEventFilter 中的处理
+    const XIEventSource &source = xiEventSources[event->timestamp() % XIEventSourceCount];
+
+    if (source.time == event->timestamp())
+        return source.type;
 
     return UnknowDevice;
 }
 
-void XcbNativeEventFilter::updateXIDeviceInfoMap()
+XcbNativeEventFilter::XIDeviceInfos XcbNativeEventFilter::xiDeviceInfo(quint16 deviceId)
 {
-    xiDeviceInfoMap.clear();
+    auto device = xiDeviceInfoMap.constFind(deviceId);
+
+    if (Q_LIKELY(device != xiDeviceInfoMap.constEnd()))
+        return device.value();
+
+    // 无法识别的设备也需要缓存，避免每个事件都查询一次
+    const XIDeviceInfos info = classifyXIDevice(deviceId);
+    xiDeviceInfoMap.insert(deviceId, info);
 
+    return info;
+}
+
+XcbNativeEventFilter::XIDeviceInfos XcbNativeEventFilter::classifyXIDevice(quint16 deviceId) const
+{
     QXcbConnection *xcb_connect = DPlatformIntegration::xcbConnection();
 
 #if QT_VERSION < QT_VERSION_CHECK(5, 12, 0)
@@ -293,41 +371,54 @@ void XcbNativeEventFilter::updateXIDeviceInfoMap()
     Display *xDisplay = reinterpret_cast<Display *>(xcb_connect->xlib_display());
 #endif
     int deviceCount = 0;
-    XIDeviceInfo *devices = XIQueryDevice(xDisplay, XIAllDevices, &deviceCount);
-
-    for (int i = 0; i < deviceCount; ++i) {
-        // Only non-master pointing devices are relevant here.
-        if (devices[i].use != XISlavePointer)
-            continue;
+    XIDeviceInfo *devices = XIQueryDevice(xDisplay, deviceId, &deviceCount);
+    // Only non-master pointing devices are relevant here.
+    const bool isSlavePointer = devices && deviceCount > 0 && devices[0].use == XISlavePointer;
 
-        int nprops;
-        Atom *props = XIListProperties(xDisplay, devices[i].deviceid, &nprops);
-
-        if (!nprops)
-            return;
+    // XIQueryDevice may return NULL..boom
+    if (devices)
+        XIFreeDeviceInfo(devices);
 
-        char *name;
+    if (!isSlavePointer)
+        return XIDeviceInfos();
 
-        for (int j = 0; j < nprops; ++j) {
-            name = XGetAtomName(xDisplay, props[j]);
+    int nprops = 0;
+    Atom *props = XIListProperties(xDisplay, deviceId, &nprops);
+    XIDeviceInfos info;
 
-            if (QByteArrayLiteral("Synaptics Off") == name
-                    || QByteArrayLiteral("libinput Tapping Enabled") == name) {
-                xiDeviceInfoMap[devices[i].deviceid] = XIDeviceInfos(TouchapdDevice);
-            } else if (QByteArrayLiteral("Button Labels") == name
-                       || QByteArrayLiteral("libinput Button Scrolling Button") == name) {
-                xiDeviceInfoMap[devices[i].deviceid] = XIDeviceInfos(MouseDevice);
-            }
+    for (int i = 0; i < nprops; ++i) {
+        const xcb_atom_t atom = props[i];
 
-            XFree(name);
+        if (atom == xiTouchpadPropertyAtoms[0] || atom == xiTouchpadPropertyAtoms[1]) {
+            info = XIDeviceInfos(TouchapdDevice);
+        } else if (atom == xiMousePropertyAtoms[0] || atom == xiMousePropertyAtoms[1]) {
+            info = XIDeviceInfos(MouseDevice);
         }
+    }
 
+    if (props)
         XFree(props);
-    }
 
-    // XIQueryDevice may return NULL..boom
-    if (devices)
-        XIFreeDeviceInfo(devices);
+    return info;
+}
+
+void XcbNativeEventFilter::handleXIHierarchyEvent(const void *event)
+{
+    const xXIHierarchyEvent *xiEvent = reinterpret_cast<const xXIHierarchyEvent *>(event);
+
+    // We only care about hotplugged devices
+    if (!(xiEvent->flags & (XISlaveRemoved | XISlaveAdded | XIDeviceEnabled | XIDeviceDisabled)))
+        return;
+
+    // 与 XI_Motion 等事件相同，xcb在事件的前32个字节之后插入了4个字节的full_sequence字段
+    const xXIHierarchyInfo *infos = reinterpret_cast<const xXIHierarchyInfo *>(reinterpret_cast<const char *>(event)
+                                                                                + sizeof(xXIHierarchyEvent) + sizeof(uint32_t));
+
+    for (int i = 0; i < xiEvent->num_info; ++i) {
+        // 新增的设备在产生事件时再分类，id可能被复用，已移除的设备也要清理
+        if (infos[i].flags & (XISlaveRemoved | XISlaveAdded | XIDeviceEnabled | XIDeviceDisabled))
+            xiDeviceInfoMap.remove(infos[i].deviceid);
+    }
 }
 
 DPP_END_NAMESPACE
@@ -42,12 +42,39 @@ public:
     DeviceType xiEventSource(const QInputEvent *event) const;
 
 private:
-    void updateXIDeviceInfoMap();
+    // 关心的窗口属性变化，RootWindowOnly之后的值只处理根窗口上的属性
+    enum PropertyAction {
+        MotifWmHintsChanged,
+        WallpaperSharedChanged,
+        RootWindowOnly,
+        NetSupportedChanged = RootWindowOnly,
+        SupportingWmCheckChanged,
+        BlurBehindRegionChanged,
+        ClientListStackingChanged,
+        CompositeTogglingChanged
+    };
+
+    void initPropertyActions();
+    void handlePropertyNotifyEvent(const xcb_property_notify_event_t *event);
+    XIDeviceInfos xiDeviceInfo(quint16 deviceId);
+    XIDeviceInfos classifyXIDevice(quint16 deviceId) const;
+    void handleXIHierarchyEvent(const void *event);
 
     QXcbConnection *m_connection;
     uint8_t m_damageFirstEvent;
+    QHash<xcb_atom_t, PropertyAction> m_propertyActions;
+    // 设备在首次产生事件时才进行分类，设备插拔时只移除对应的设备
     QHash<quint16, XIDeviceInfos> xiDeviceInfoMap;
-    QPair<quint32, XIDeviceInfos> lastXIEventDeviceInfo;
+    xcb_atom_t xiTouchpadPropertyAtoms[2];
+    xcb_atom_t xiMousePropertyAtoms[2];
+
+    // 最近的XI2事件来源，以时间戳为键直接映射，Qt事件中只能拿到时间戳
+    struct XIEventSource {
+        quint32 time = 0;
+        DeviceType type = UnknowDevice;
+    };
+    enum { XIEventSourceCount = 64 };
+    XIEventSource xiEventSources[XIEventSourceCount];
 };
 
 DPP_END_NAMESPACE